@@ -0,0 +1,82 @@
+#include <math.h>
+
+#include "bias_tracker.h"
+
+// Clear the statistics
+void resetWelford(WelfordStats &stats)
+{
+    stats.count = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        stats.mean[k] = 0;
+        stats.m2[k] = 0;
+    }
+}
+
+// Add one sample
+void updateWelford(WelfordStats &stats, const float sample[3])
+{
+    stats.count++;
+    for (int k = 0; k < 3; ++k)
+    {
+        float delta = sample[k] - stats.mean[k];
+        stats.mean[k] += delta / stats.count;
+        stats.m2[k] += delta * (sample[k] - stats.mean[k]);
+    }
+}
+
+// Sample variance of one axis
+float welfordVariance(const WelfordStats &stats, int axis)
+{
+    return (stats.count < 2) ? 0.0f : stats.m2[axis] / (stats.count - 1);
+}
+
+// Start tracking from a known calibration
+void initBiasTracker(BiasTracker &tracker, const RotationSensor_Calibration &cal, float still_variance, float drift_bound)
+{
+    resetWelford(tracker.window);
+    tracker.still_variance = still_variance;
+    tracker.drift_bound = drift_bound;
+    for (int k = 0; k < 3; ++k)
+    {
+        tracker.offset[k] = cal.offset[k];
+    }
+}
+
+// Feed one raw idle sample
+BiasUpdate updateBiasTracker(BiasTracker &tracker, const RotationSensor_RawValues &raw)
+{
+    float sample[3] = {(float)raw.x_axis_value, (float)raw.y_axis_value, (float)raw.z_axis_value};
+    updateWelford(tracker.window, sample);
+    if (tracker.window.count < BIAS_WINDOW_SAMPLES)
+    {
+        return BIAS_PENDING;
+    }
+
+    BiasUpdate result = BIAS_REFINED;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (welfordVariance(tracker.window, k) > tracker.still_variance)
+        {
+            result = BIAS_MOVING;
+            break;
+        }
+        // A quiet window far from the offset is drift (or a slow steady turn);
+        // either way the thresholds can no longer be trusted
+        if (fabsf(tracker.window.mean[k] - tracker.offset[k]) > tracker.drift_bound)
+        {
+            result = BIAS_DRIFTED;
+        }
+    }
+
+    if (result == BIAS_REFINED)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            tracker.offset[k] += BIAS_REFINE_WEIGHT * (tracker.window.mean[k] - tracker.offset[k]);
+        }
+    }
+
+    resetWelford(tracker.window);
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef __BIAS_TRACKER_H
+#define __BIAS_TRACKER_H
+
+#include <stdint.h>
+
+#include "motion.h"
+
+// Idle samples per stillness window
+#define BIAS_WINDOW_SAMPLES 32
+// Weight given to each new still window when refining the offset
+#define BIAS_REFINE_WEIGHT 0.25f
+
+// Running mean and variance of the three axes (Welford's algorithm)
+typedef struct
+{
+    uint32_t count;
+    float mean[3];
+    float m2[3]; // Sum of squared deviations from the running mean
+} WelfordStats;
+
+// Outcome of feeding one idle sample to the tracker
+typedef enum
+{
+    BIAS_PENDING, // Window not complete yet
+    BIAS_MOVING,  // Window too noisy to be at rest; discarded
+    BIAS_REFINED, // Still window close to the offset; offset refined
+    BIAS_DRIFTED  // Still window beyond the drift bound; recalibration needed
+} BiasUpdate;
+
+// Zero-rate level tracked from idle samples
+typedef struct
+{
+    WelfordStats window;  // Statistics of the current window
+    float still_variance; // Per-axis variance (counts^2) at or below which the board is at rest
+    float drift_bound;    // Largest offset change (counts) absorbed without recalibrating
+    float offset[3];      // Refined zero-rate level (counts)
+} BiasTracker;
+
+// Clear the statistics
+void resetWelford(WelfordStats &stats);
+
+// Add one sample
+void updateWelford(WelfordStats &stats, const float sample[3]);
+
+// Sample variance of one axis (0 with fewer than two samples)
+float welfordVariance(const WelfordStats &stats, int axis);
+
+// Start tracking from a known calibration
+void initBiasTracker(BiasTracker &tracker, const RotationSensor_Calibration &cal, float still_variance, float drift_bound);
+
+// Feed one raw (uncalibrated) idle sample
+BiasUpdate updateBiasTracker(BiasTracker &tracker, const RotationSensor_RawValues &raw);
+
+#endif
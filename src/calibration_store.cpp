@@ -0,0 +1,128 @@
+#include <mbed.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "calibration_store.h"
+
+// Identifies a calibration record written by this firmware
+#define CALIBRATION_MAGIC 0x43414c31 // "CAL1"
+
+// Record layout in flash, padded to a whole number of program pages
+typedef struct
+{
+    uint32_t magic;
+    uint8_t scale_conf;
+    uint8_t reserved[3];
+    RotationSensor_Calibration cal;
+    uint32_t checksum;
+} CalibrationRecord;
+
+static const size_t recordSize = (sizeof(CalibrationRecord) + 31) & ~(size_t)31;
+
+// Calibration last loaded from or written to flash, and when
+static RotationSensor_Calibration storedCal;
+static bool storedValid = false;
+static Kernel::Clock::time_point storedTime;
+
+// Simple additive checksum over everything before the checksum field
+static uint32_t recordChecksum(const CalibrationRecord &rec)
+{
+    const uint8_t *bytes = (const uint8_t *)&rec;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(CalibrationRecord, checksum); i++)
+    {
+        sum = (sum << 1 | sum >> 31) + bytes[i];
+    }
+    return sum;
+}
+
+// Start address of the sector holding the record: the first sector of the second
+// bank (16 KB, and erasable while code runs from bank 1) when the firmware ends
+// before it, otherwise the last sector
+static uint32_t recordAddress(FlashIAP &flash)
+{
+    uint32_t bank2 = flash.get_flash_start() + flash.get_flash_size() / 2;
+    if (FLASHIAP_APP_ROM_END_ADDR <= bank2)
+    {
+        return bank2;
+    }
+
+    uint32_t end = flash.get_flash_start() + flash.get_flash_size();
+    return end - flash.get_sector_size(end - 1);
+}
+
+// Load the calibration saved for the given full-scale setting
+bool loadRotationCalibration(uint8_t scale_conf, RotationSensor_Calibration &cal)
+{
+    FlashIAP flash;
+    CalibrationRecord rec;
+
+    flash.init();
+    int read_result = flash.read(&rec, recordAddress(flash), sizeof(rec));
+    flash.deinit();
+
+    if (read_result != 0 || rec.magic != CALIBRATION_MAGIC || rec.scale_conf != scale_conf ||
+        rec.checksum != recordChecksum(rec))
+    {
+        return false;
+    }
+
+    cal = rec.cal;
+    storedCal = rec.cal;
+    storedValid = true;
+    storedTime = Kernel::Clock::now();
+    return true;
+}
+
+// Save the calibration to the last flash sector
+bool storeRotationCalibration(uint8_t scale_conf, const RotationSensor_Calibration &cal)
+{
+    FlashIAP flash;
+    uint8_t page[recordSize];
+    CalibrationRecord rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = CALIBRATION_MAGIC;
+    rec.scale_conf = scale_conf;
+    rec.cal = cal;
+    rec.checksum = recordChecksum(rec);
+
+    memset(page, 0xff, sizeof(page));
+    memcpy(page, &rec, sizeof(rec));
+
+    flash.init();
+    uint32_t address = recordAddress(flash);
+    int write_result = -1;
+    if (recordSize % flash.get_page_size() == 0 && flash.erase(address, flash.get_sector_size(address)) == 0)
+    {
+        write_result = flash.program(page, address, recordSize);
+    }
+    flash.deinit();
+
+    if (write_result != 0)
+    {
+        return false;
+    }
+    storedCal = cal;
+    storedValid = true;
+    storedTime = Kernel::Clock::now();
+    return true;
+}
+
+// Save a background-refined calibration if it has moved enough, rate-limited
+bool refreshRotationCalibration(uint8_t scale_conf, const RotationSensor_Calibration &cal)
+{
+    if (storedValid && Kernel::Clock::now() - storedTime < CALIBRATION_REFRESH_INTERVAL)
+    {
+        return false;
+    }
+
+    bool moved = !storedValid;
+    for (int k = 0; k < 3; ++k)
+    {
+        int delta = cal.offset[k] - storedCal.offset[k];
+        moved = moved || delta >= CALIBRATION_REFRESH_COUNTS || delta <= -CALIBRATION_REFRESH_COUNTS;
+    }
+
+    return moved && storeRotationCalibration(scale_conf, cal);
+}
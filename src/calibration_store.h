@@ -0,0 +1,29 @@
+#ifndef __CALIBRATION_STORE_H
+#define __CALIBRATION_STORE_H
+
+#include <stdint.h>
+
+#include "motion.h"
+
+// Smallest offset change (counts) worth rewriting the stored calibration for
+#define CALIBRATION_REFRESH_COUNTS 2
+// Shortest time between two background rewrites
+#define CALIBRATION_REFRESH_INTERVAL 1h
+
+// Load the calibration saved for the given full-scale setting; returns false if the
+// flash holds none (or one taken at a different scale)
+bool loadRotationCalibration(uint8_t scale_conf, RotationSensor_Calibration &cal);
+
+// Save the calibration, erasing its flash sector first. The record lives in the
+// first (16 KB) sector of bank 2 when the firmware fits in bank 1, so code keeps
+// running from bank 1 during the erase; the calling thread still blocks for the
+// erase, roughly 0.25-0.5 s (1-2 s if it falls back to the last, 128 KB, sector).
+bool storeRotationCalibration(uint8_t scale_conf, const RotationSensor_Calibration &cal);
+
+// Save a calibration refined in the background, but only if an offset has moved by
+// at least CALIBRATION_REFRESH_COUNTS from the stored record and the last load or
+// store was CALIBRATION_REFRESH_INTERVAL ago; this bounds both the erase stalls and
+// the flash wear. Returns true if the record was rewritten.
+bool refreshRotationCalibration(uint8_t scale_conf, const RotationSensor_Calibration &cal);
+
+#endif
@@ -23,6 +23,21 @@
 #define FIFO_CTRL_CONFIG_REG   0x2E // Configures FIFO mode and threshold
 #define FIFO_STATUS_REG        0x2F // Reflects FIFO current fill level and status
 
+// FIFO modes (FIFO_CTRL_CONFIG_REG bits 7:5) and watermark (bits 4:0)
+#define FIFO_MODE_BYPASS           0x00 // FIFO disabled, output registers only
+#define FIFO_MODE_FIFO             0x20 // Fill the FIFO, then stop
+#define FIFO_MODE_STREAM           0x40 // Keep the newest samples, overwriting the oldest
+#define FIFO_MODE_STREAM_TO_FIFO   0x60 // Stream until an INT1 event, then FIFO
+#define FIFO_MODE_BYPASS_TO_STREAM 0x80 // Bypass until an INT1 event, then stream
+#define FIFO_WATERMARK_MASK        0x1F
+
+// FIFO status bits (FIFO_STATUS_REG)
+#define FIFO_STATUS_WATERMARK   0x80 // Level has reached the watermark
+#define FIFO_STATUS_OVERRUN     0x40 // FIFO full, oldest sample overwritten
+#define FIFO_STATUS_EMPTY       0x20 // No samples stored
+#define FIFO_STATUS_LEVEL_MASK  0x1F // Number of unread samples
+#define FIFO_DEPTH              32   // Samples the FIFO can hold
+
 // Interrupt configuration registers
 #define INT1_CONFIG_REG        0x30 // Configures conditions for INT1 generation
 #define INT1_SOURCE_REG        0x31 // Indicates which interrupt event has occurred
@@ -55,6 +70,11 @@
 #define HPF_DISABLED_200HZ       0x00
 #define HPF_DISABLED_400HZ       0x00
 #define HPF_DISABLED_800HZ       0x00
+// Normal mode (the filter resets when REFERENCE_REG is read), 0.1 Hz cutoff at 100 Hz ODR
+#define HPF_NORMAL_100HZ_CUTOFF_0_1HZ 0x06
+
+// Reading this register resets the high-pass filter to the current rate
+#define REFERENCE_REG          0x25
 
 // Interrupt configuration bits
 #define INT1_PIN_ENABLE         0x80 // Enable INT1 pin output
@@ -70,9 +90,28 @@
 #define INT1_Y_LOW_ENABLE       0x04 // Trigger on Y-axis low threshold event
 #define INT1_X_HIGH_ENABLE      0x02 // Trigger on X-axis high threshold event
 #define INT1_X_LOW_ENABLE       0x01 // Trigger on X-axis low threshold event
+#define INT1_CONFIG_LATCH       0x40 // (INT1_CONFIG_REG) Hold INT1 until INT1_SOURCE_REG is read
+#define INT1_THRESHOLD_MAX      0x7FFF // Thresholds are 15-bit, high register holds bits 14:8
+#define INT1_DURATION_MASK      0x7F // Samples an event must persist (INT1_DURATION_REG)
 
 // INT2 pin configurations
 #define INT2_DATA_READY         0x08 // Data-ready signal on DRDY/INT2 pin
+#define INT2_FIFO_WATERMARK     0x04 // FIFO watermark signal on DRDY/INT2 pin
+#define INT2_FIFO_OVERRUN       0x02 // FIFO overrun signal on DRDY/INT2 pin
+#define INT2_FIFO_EMPTY         0x01 // FIFO empty signal on DRDY/INT2 pin
+
+// Advanced features (ADV_FEATURES_CTRL_REG) bits
+#define FIFO_ENABLE             0x40 // Route samples through the FIFO
+#define HPF_ENABLE              0x10 // Enable the high-pass filter
+#define INT1_SEL_HPF            0x04 // INT1 compares high-pass filtered data (outputs stay unfiltered)
+
+// Data status bits (DATA_STATUS_REG)
+#define DATA_STATUS_XYZ_OVERRUN 0x80 // New X, Y, Z data overwrote unread data
+#define DATA_STATUS_XYZ_READY   0x08 // New X, Y, Z data available
+
+// SPI command bits
+#define SPI_READ_FLAG           0x80 // Read access
+#define SPI_AUTO_INCREMENT_FLAG 0x40 // Increment the register address after each byte
 
 // Full-scale range selections
 #define FULL_SCALE_245_DPS      0x00 // 245 dps
@@ -85,14 +124,9 @@
 #define SENSITIVITY_500_DPS_PER_DIGIT  0.0175f
 #define SENSITIVITY_2000_DPS_PER_DIGIT 0.07f
 
-// Conversion and placement parameters
-#define MOUNT_POSITION           1       
-#define DEGREES_TO_RADIANS       0.0175f // Conversion factor for degrees to radians
-
 // Power management states
 #define DEVICE_POWER_ON          0x0F // Power on the gyroscope
 #define DEVICE_POWER_OFF         0x00 // Power off the gyroscope
 
-// Sampling time and intervals
-#define SAMPLE_TIME_MS_20        20      // Sample time of 20 ms
-#define SAMPLE_INTERVAL_S_0_05   0.005f  // Sample interval of 0.05 seconds
+// Gesture buffer sizing
+#define MAX_GESTURE_SAMPLES      256     // Longest gesture (in samples) the scoring buffers can hold
@@ -0,0 +1,174 @@
+#include <string.h>
+#include <math.h>
+
+#include "decimator.h"
+
+// Count cycles with the DWT unit on Cortex-M3/M4 targets; elsewhere cost reads as zero
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+#include "cmsis.h"
+#define DECIMATOR_CYCLE_COUNTER 1
+#else
+#define DECIMATOR_CYCLE_COUNTER 0
+#endif
+
+// Passband edge as a fraction of the output Nyquist rate
+#define DECIMATOR_FIR_CUTOFF 0.8f
+
+static inline uint32_t readCycleCounter()
+{
+#if DECIMATOR_CYCLE_COUNTER
+    return DWT->CYCCNT;
+#else
+    return 0;
+#endif
+}
+
+static void startCycleCounter()
+{
+#if DECIMATOR_CYCLE_COUNTER
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+// Hamming-windowed sinc low-pass with unity DC gain
+static void designLowPass(float coeff[], size_t taps, uint8_t factor)
+{
+    const float pi = 3.14159265f;
+    float fc = DECIMATOR_FIR_CUTOFF * 0.5f / factor; // Cycles per input sample
+    float centre = (taps - 1) * 0.5f;
+    float sum = 0;
+
+    for (size_t n = 0; n < taps; ++n)
+    {
+        float t = n - centre;
+        float sinc = (t == 0) ? 2 * fc : sinf(2 * pi * fc * t) / (pi * t);
+        float window = 0.54f - 0.46f * cosf(2 * pi * n / (taps - 1));
+        coeff[n] = sinc * window;
+        sum += coeff[n];
+    }
+    for (size_t n = 0; n < taps; ++n)
+    {
+        coeff[n] /= sum;
+    }
+}
+
+// Round a CIC comb output back to input units
+static inline int16_t cicScale(int32_t v, int32_t gain)
+{
+    v = (v >= 0) ? (v + gain / 2) / gain : (v - gain / 2) / gain;
+    return (int16_t)v;
+}
+
+// Configure a decimator and clear its state
+bool initDecimator(Decimator &dec, DecimatorType type, uint8_t factor)
+{
+    if (factor == 0 || factor > DECIMATOR_MAX_FACTOR)
+    {
+        return false;
+    }
+
+    memset(&dec, 0, sizeof(dec));
+    dec.type = type;
+    dec.factor = factor;
+
+    if (type == DECIMATE_FIR && factor > 1)
+    {
+        dec.taps = (size_t)factor * DECIMATOR_FIR_TAPS_PER_PHASE;
+        designLowPass(dec.coeff, dec.taps, factor);
+    }
+    else
+    {
+        dec.taps = 1;
+        dec.coeff[0] = 1.0f;
+    }
+
+    startCycleCounter();
+    return true;
+}
+
+// Push one calibrated raw sample
+bool pushDecimator(Decimator &dec, const RotationSensor_RawValues &in, RotationSensor_RawValues &out)
+{
+    uint32_t startCycles = readCycleCounter();
+    int16_t x[3] = {in.x_axis_value, in.y_axis_value, in.z_axis_value};
+    int16_t y[3];
+
+    dec.stats.inputs++;
+    bool emit = (++dec.phase >= dec.factor);
+
+    if (dec.type == DECIMATE_CIC)
+    {
+        // Integrators run at the input rate, combs only at the output rate
+        for (size_t k = 0; k < 3; ++k)
+        {
+            uint32_t acc = (uint32_t)(int32_t)x[k];
+            for (size_t s = 0; s < DECIMATOR_CIC_ORDER; ++s)
+            {
+                dec.integrator[k][s] += acc;
+                acc = dec.integrator[k][s];
+            }
+
+            if (emit)
+            {
+                for (size_t s = 0; s < DECIMATOR_CIC_ORDER; ++s)
+                {
+                    uint32_t delayed = dec.comb[k][s];
+                    dec.comb[k][s] = acc;
+                    acc -= delayed;
+                }
+
+                int32_t gain = 1;
+                for (size_t s = 0; s < DECIMATOR_CIC_ORDER; ++s)
+                {
+                    gain *= dec.factor;
+                }
+                y[k] = cicScale((int32_t)acc, gain);
+            }
+        }
+    }
+    else
+    {
+        // Store the sample newest-first; the dot product is only evaluated for outputs
+        dec.head = (dec.head == 0) ? dec.taps - 1 : dec.head - 1;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            dec.history[k][dec.head] = x[k];
+            dec.history[k][dec.head + dec.taps] = x[k];
+        }
+
+        if (emit)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const float *window = &dec.history[k][dec.head];
+                float acc = 0;
+                for (size_t n = 0; n < dec.taps; ++n)
+                {
+                    acc += dec.coeff[n] * window[n];
+                }
+                // Ringing on a saturated input can overshoot the int16 range
+                acc = (acc > INT16_MAX) ? INT16_MAX : (acc < INT16_MIN) ? INT16_MIN : acc;
+                y[k] = (int16_t)lrintf(acc);
+            }
+        }
+    }
+
+    if (emit)
+    {
+        dec.phase = 0;
+        out.x_axis_value = y[0];
+        out.y_axis_value = y[1];
+        out.z_axis_value = y[2];
+        dec.stats.outputs++;
+    }
+
+    uint32_t cycles = readCycleCounter() - startCycles;
+    dec.stats.total_cycles += cycles;
+    if (cycles > dec.stats.max_cycles)
+    {
+        dec.stats.max_cycles = cycles;
+    }
+
+    return emit;
+}
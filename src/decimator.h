@@ -0,0 +1,60 @@
+#ifndef __DECIMATOR_H
+#define __DECIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "motion.h"
+
+// Largest supported decimation factor (bounds the CIC register growth and FIR length)
+#define DECIMATOR_MAX_FACTOR 16
+// Number of integrator/comb stages of the CIC filter
+#define DECIMATOR_CIC_ORDER 3
+// FIR taps per output phase; the filter has factor * this many taps
+#define DECIMATOR_FIR_TAPS_PER_PHASE 4
+#define DECIMATOR_MAX_TAPS (DECIMATOR_MAX_FACTOR * DECIMATOR_FIR_TAPS_PER_PHASE)
+
+// Anti-aliasing filter applied before dropping samples
+typedef enum
+{
+    DECIMATE_CIC, // Cascaded boxcar sums in integer arithmetic; cheapest, sinc^N response
+    DECIMATE_FIR  // Windowed-sinc FIR evaluated only at output instants; flatter passband
+} DecimatorType;
+
+// Cost of the filter measured on the target, in CPU cycles
+typedef struct
+{
+    uint32_t inputs;       // Samples pushed
+    uint32_t outputs;      // Samples produced
+    uint32_t total_cycles; // Cycles spent in pushDecimator
+    uint32_t max_cycles;   // Worst single push (an output instant)
+} DecimatorStats;
+
+// Decimating low-pass filter over the three gyro axes
+typedef struct
+{
+    DecimatorType type;
+    uint8_t factor; // Input samples per output sample
+    uint8_t phase;  // Inputs since the last output
+
+    // CIC state, unsigned so the integrators wrap; the wrap cancels in the combs
+    uint32_t integrator[3][DECIMATOR_CIC_ORDER];
+    uint32_t comb[3][DECIMATOR_CIC_ORDER];
+
+    // FIR state; history is stored twice so every window is contiguous
+    size_t taps;
+    size_t head;
+    float coeff[DECIMATOR_MAX_TAPS];
+    float history[3][2 * DECIMATOR_MAX_TAPS];
+
+    DecimatorStats stats;
+} Decimator;
+
+// Configure a decimator for factor (1..DECIMATOR_MAX_FACTOR) and clear its state;
+// returns false if the factor is out of range
+bool initDecimator(Decimator &dec, DecimatorType type, uint8_t factor);
+
+// Push one calibrated raw sample; returns true and fills out every factor-th call
+bool pushDecimator(Decimator &dec, const RotationSensor_RawValues &in, RotationSensor_RawValues &out);
+
+#endif
@@ -89,6 +89,26 @@ void LCD_DISCO_F429ZI::SetLayerAddress(uint32_t LayerIndex, uint32_t Address)
   BSP_LCD_SetLayerAddress(LayerIndex, Address);
 }
 
+void LCD_DISCO_F429ZI::SetPixelFormat(uint32_t LayerIndex, uint32_t PixelFormat)
+{
+  BSP_LCD_SetPixelFormat(LayerIndex, PixelFormat);
+}
+
+void LCD_DISCO_F429ZI::EnableDoubleBuffer(uint32_t LayerIndex)
+{
+  BSP_LCD_EnableDoubleBuffer(LayerIndex);
+}
+
+void LCD_DISCO_F429ZI::SwapBuffers(uint32_t LayerIndex)
+{
+  BSP_LCD_SwapBuffers(LayerIndex);
+}
+
+void LCD_DISCO_F429ZI::WaitForFlip(void)
+{
+  BSP_LCD_WaitForFlip();
+}
+
 void LCD_DISCO_F429ZI::SetLayerWindow(uint16_t LayerIndex, uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
 {
   BSP_LCD_SetLayerWindow(LayerIndex, Xpos, Ypos, Width, Height);
@@ -204,6 +224,16 @@ void LCD_DISCO_F429ZI::DrawBitmap(uint32_t X, uint32_t Y, uint8_t *pBmp)
   BSP_LCD_DrawBitmap(X, Y, pBmp);
 }
 
+void LCD_DISCO_F429ZI::SaveLines(uint16_t Ypos, uint16_t Height, uint32_t Dst)
+{
+  BSP_LCD_SaveLines(Ypos, Height, Dst);
+}
+
+void LCD_DISCO_F429ZI::RestoreLines(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Src)
+{
+  BSP_LCD_RestoreLines(Xpos, Ypos, Width, Height, Src);
+}
+
 void LCD_DISCO_F429ZI::FillRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height)
 {
   BSP_LCD_FillRect(Xpos, Ypos, Width, Height);
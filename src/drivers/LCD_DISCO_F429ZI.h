@@ -117,6 +117,35 @@ public:
     */
   void SetLayerAddress(uint32_t LayerIndex, uint32_t Address);
 
+  /**
+    * @brief  Switches the pixel format of a layer; redraw it afterwards.
+    * @param  LayerIndex: the Layer foreground or background
+    * @param  PixelFormat: LCD_PIXEL_FORMAT_ARGB8888, LCD_PIXEL_FORMAT_RGB565 or LCD_PIXEL_FORMAT_L8
+    * @retval None
+    */
+  void SetPixelFormat(uint32_t LayerIndex, uint32_t PixelFormat);
+
+  /**
+    * @brief  Gives a layer a back buffer; drawing goes there until SwapBuffers.
+    * @param  LayerIndex: the Layer foreground or background
+    * @retval None
+    */
+  void EnableDoubleBuffer(uint32_t LayerIndex);
+
+  /**
+    * @brief  Shows what was drawn into the back buffer at the next vertical blanking.
+    * @param  LayerIndex: the Layer foreground or background
+    * @retval None
+    */
+  void SwapBuffers(uint32_t LayerIndex);
+
+  /**
+    * @brief  Waits until the last requested swap is on screen.
+    * @param  None
+    * @retval None
+    */
+  void WaitForFlip(void);
+
   /**
     * @brief  Sets the Display window.
     * @param  LayerIndex: layer index
@@ -312,6 +341,26 @@ public:
     */
   void DrawBitmap(uint32_t X, uint32_t Y, uint8_t *pBmp);
 
+  /**
+    * @brief  Copies whole lines of the layer to memory, in the layer pixel format.
+    * @param  Ypos: first line
+    * @param  Height: number of lines
+    * @param  Dst: destination, holding GetXSize() pixels per line
+    * @retval None
+    */
+  void SaveLines(uint16_t Ypos, uint16_t Height, uint32_t Dst);
+
+  /**
+    * @brief  Copies a span of lines saved by SaveLines back in place.
+    * @param  Xpos: first column of the span
+    * @param  Ypos: first line, as saved
+    * @param  Width: span width
+    * @param  Height: number of lines
+    * @param  Src: the saved lines
+    * @retval None
+    */
+  void RestoreLines(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Src);
+
   /**
     * @brief  Displays a full rectangle.
     * @param  Xpos: the X position
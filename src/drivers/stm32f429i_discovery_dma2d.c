@@ -0,0 +1,446 @@
+/**
+  ******************************************************************************
+  * @file    stm32f429i_discovery_dma2d.c
+  * @brief   This file provides an interrupt driven job queue for the DMA2D.
+  ******************************************************************************
+  */
+
+/* File Info : -----------------------------------------------------------------
+                                   User NOTES
+1. How To use this driver:
+--------------------------
+   - Call BSP_DMA2D_Init() once; BSP_LCD_Init() does it.
+   - Submit fills, copies, pixel format conversions and blends with
+     BSP_DMA2D_Submit() or one of its helpers. The call returns as soon as the
+     job is queued; jobs run in submission order, each started from the
+     transfer complete interrupt of the one before.
+   - Every submission returns a fence. BSP_DMA2D_Wait() blocks until that job
+     and everything queued before it are done; BSP_DMA2D_WaitIdle() drains the
+     queue. Wait before touching memory a queued job still reads or writes.
+   - Waiting threads sleep on an RTOS event flag set by the transfer complete
+     interrupt, so other threads run meanwhile. Before the kernel runs, or in
+     interrupt context, the waits poll instead.
+   - Only the registers that differ from the previous job are reprogrammed.
+   - Submit from thread context only: a full queue waits for a free slot the
+     same way.
+------------------------------------------------------------------------------*/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f429i_discovery_dma2d.h"
+#include "cmsis_nvic.h" // Added for mbed
+#include "cmsis_os2.h"  // Added for mbed
+
+/** @addtogroup BSP
+  * @{
+  */
+
+/** @addtogroup STM32F429I_DISCOVERY
+  * @{
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D STM32F429I DISCOVERY DMA2D
+  * @brief This file includes the DMA2D job queue
+  * @{
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Private_TypesDefinitions STM32F429I DISCOVERY DMA2D Private TypesDefinitions
+  * @{
+  */
+/* Last value written to each configuration register */
+typedef struct
+{
+  uint32_t CR;
+  uint32_t OPFCCR;
+  uint32_t OCOLR;
+  uint32_t OOR;
+  uint32_t FGPFCCR;
+  uint32_t FGCOLR;
+  uint32_t FGOR;
+  uint32_t BGPFCCR;
+  uint32_t BGOR;
+} DMA2D_ShadowTypeDef;
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Private_Defines STM32F429I DISCOVERY DMA2D Private Defines
+  * @{
+  */
+#define DMA2D_IRQ_ENABLES      (DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE)
+#define DMA2D_IRQ_FLAGS        (DMA2D_ISR_TCIF | DMA2D_ISR_TEIF | DMA2D_ISR_CEIF)
+#define DMA2D_AM_POSITION      16
+#define DMA2D_PL_POSITION      16
+
+/* Event flag raised each time a job retires. Every waiter consumes it, so with
+   several waiters one may miss a wake-up; the timeout bounds that to a tick. */
+#define DMA2D_DONE_FLAG        0x00000001U
+#define DMA2D_WAIT_TICKS       1
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Private_Variables STM32F429I DISCOVERY DMA2D Private Variables
+  * @{
+  */
+static DMA2D_JobTypeDef Queue[DMA2D_QUEUE_DEPTH];
+static volatile uint32_t Submitted = 0;   /* Fence of the newest queued job */
+static volatile uint32_t Completed = 0;   /* Fence of the newest finished job */
+static volatile uint8_t  Running = 0;     /* A transfer is in flight */
+static DMA2D_ShadowTypeDef Shadow;
+static uint8_t ShadowValid = 0;
+static osEventFlagsId_t DoneFlags = NULL; /* Set from the interrupt, waited on by threads */
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Private_FunctionPrototypes STM32F429I DISCOVERY DMA2D Private FunctionPrototypes
+  * @{
+  */
+static void StartJob(const DMA2D_JobTypeDef *pJob);
+static void WaitForRetire(void);
+static void DMA2D_IRQHandler_Queue(void);
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Private_Functions STM32F429I DISCOVERY DMA2D Private Functions
+  * @{
+  */
+
+/**
+  * @brief  Initializes the DMA2D queue and its interrupt.
+  */
+void BSP_DMA2D_Init(void)
+{
+  __HAL_RCC_DMA2D_CLK_ENABLE();
+
+  Submitted = 0;
+  Completed = 0;
+  Running = 0;
+  ShadowValid = 0;
+  DMA2D->IFCR = DMA2D_IRQ_FLAGS;
+
+  // Added for mbed
+  if (DoneFlags == NULL)
+  {
+    DoneFlags = osEventFlagsNew(NULL);
+  }
+
+  // Added for mbed
+  IRQn_Type irqn = DMA2D_IRQn;
+  NVIC_ClearPendingIRQ(irqn);
+  NVIC_DisableIRQ(irqn);
+  NVIC_SetPriority(irqn, DMA2D_IRQ_PREPRIO);
+  NVIC_SetVector(irqn, (uint32_t)DMA2D_IRQHandler_Queue);
+  NVIC_EnableIRQ(irqn);
+}
+
+/**
+  * @brief  Queues a job, starting it at once if the DMA2D is idle.
+  * @param  pJob: the job, copied into the queue
+  * @retval Fence of the job
+  */
+uint32_t BSP_DMA2D_Submit(const DMA2D_JobTypeDef *pJob)
+{
+  uint32_t fence, primask;
+
+  /* Wait for a free slot, then claim it with interrupts masked */
+  primask = __get_PRIMASK();
+  for (;;)
+  {
+    __disable_irq();
+    if ((Submitted - Completed) < DMA2D_QUEUE_DEPTH)
+    {
+      break;
+    }
+    __set_PRIMASK(primask);
+    WaitForRetire();
+  }
+
+  fence = Submitted + 1;
+  Queue[fence % DMA2D_QUEUE_DEPTH] = *pJob;
+  Submitted = fence;
+  if (!Running)
+  {
+    Running = 1;
+    StartJob(&Queue[fence % DMA2D_QUEUE_DEPTH]);
+  }
+
+  __set_PRIMASK(primask);
+  return fence;
+}
+
+/**
+  * @brief  Gets the fence of the newest queued job.
+  * @retval Fence, done once everything submitted so far is done
+  */
+uint32_t BSP_DMA2D_GetFence(void)
+{
+  return Submitted;
+}
+
+/**
+  * @brief  Checks whether a job has finished.
+  * @param  Fence: fence returned on submission
+  * @retval 1 if the job and all jobs before it are done, 0 otherwise
+  */
+uint8_t BSP_DMA2D_IsDone(uint32_t Fence)
+{
+  return ((int32_t)(Completed - Fence) >= 0) ? 1 : 0;
+}
+
+/**
+  * @brief  Waits until a job has finished.
+  * @param  Fence: fence returned on submission
+  */
+void BSP_DMA2D_Wait(uint32_t Fence)
+{
+  while (!BSP_DMA2D_IsDone(Fence))
+  {
+    WaitForRetire();
+  }
+}
+
+/**
+  * @brief  Waits until every queued job has finished.
+  */
+void BSP_DMA2D_WaitIdle(void)
+{
+  BSP_DMA2D_Wait(Submitted);
+}
+
+/**
+  * @brief  Queues a rectangle fill.
+  * @param  Dst: first output pixel
+  * @param  xSize: rectangle width
+  * @param  ySize: rectangle height
+  * @param  OffLine: output line offset
+  * @param  ColorMode: output color mode
+  * @param  Color: fill color in the output color mode
+  * @retval Fence of the job
+  */
+uint32_t BSP_DMA2D_Fill(uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorMode, uint32_t Color)
+{
+  DMA2D_JobTypeDef job = {0};
+
+  job.Mode            = DMA2D_R2M;
+  job.Width           = xSize;
+  job.Height          = ySize;
+  job.OutputAddress   = Dst;
+  job.OutputOffset    = OffLine;
+  job.OutputColorMode = ColorMode;
+  job.OutputColor     = Color;
+
+  return BSP_DMA2D_Submit(&job);
+}
+
+/**
+  * @brief  Queues a rectangle copy between buffers of the same color mode.
+  * @param  Src: first source pixel
+  * @param  Dst: first output pixel
+  * @param  xSize: rectangle width
+  * @param  ySize: rectangle height
+  * @param  SrcOffLine: source line offset
+  * @param  DstOffLine: output line offset
+  * @param  ColorMode: color mode of both buffers (CM_ARGB8888, CM_RGB565, CM_L8, ...)
+  * @retval Fence of the job
+  */
+uint32_t BSP_DMA2D_Copy(uint32_t Src, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t SrcOffLine, uint32_t DstOffLine, uint32_t ColorMode)
+{
+  DMA2D_JobTypeDef job = {0};
+
+  job.Mode            = DMA2D_M2M;
+  job.Width           = xSize;
+  job.Height          = ySize;
+  job.OutputAddress   = Dst;
+  job.OutputOffset    = DstOffLine;
+  /* A plain copy keeps the source format; L8 and the other input-only modes
+     have no output encoding, so leave a valid one in the register */
+  job.OutputColorMode = (ColorMode <= CM_ARGB4444) ? ColorMode : DMA2D_ARGB8888;
+  job.FgAddress       = Src;
+  job.FgOffset        = SrcOffLine;
+  job.FgColorMode     = ColorMode;
+
+  return BSP_DMA2D_Submit(&job);
+}
+
+/**
+  * @brief  Queues a rectangle copy with pixel format conversion.
+  * @param  Src: first source pixel
+  * @param  Dst: first output pixel
+  * @param  xSize: rectangle width
+  * @param  ySize: rectangle height
+  * @param  SrcOffLine: source line offset
+  * @param  DstOffLine: output line offset
+  * @param  SrcColorMode: source (foreground) color mode
+  * @param  DstColorMode: output color mode
+  * @retval Fence of the job
+  */
+uint32_t BSP_DMA2D_Convert(uint32_t Src, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t SrcOffLine, uint32_t DstOffLine,
+                           uint32_t SrcColorMode, uint32_t DstColorMode)
+{
+  DMA2D_JobTypeDef job = {0};
+
+  job.Mode            = DMA2D_M2M_PFC;
+  job.Width           = xSize;
+  job.Height          = ySize;
+  job.OutputAddress   = Dst;
+  job.OutputOffset    = DstOffLine;
+  job.OutputColorMode = DstColorMode;
+  job.FgAddress       = Src;
+  job.FgOffset        = SrcOffLine;
+  job.FgColorMode     = SrcColorMode;
+  job.FgAlphaMode     = DMA2D_NO_MODIF_ALPHA;
+  job.FgColor         = 0xFF000000;
+
+  return BSP_DMA2D_Submit(&job);
+}
+
+/**
+  * @brief  Queues a blend of a solid color through an A8 coverage mask over a buffer.
+  * @param  Alpha: first coverage byte
+  * @param  Dst: first pixel of the buffer blended into
+  * @param  xSize: rectangle width
+  * @param  ySize: rectangle height
+  * @param  DstOffLine: buffer line offset
+  * @param  ColorMode: buffer color mode, one that is both an input and an
+  *         output mode (ARGB8888 to ARGB4444)
+  * @param  Color: the color, ARGB8888
+  * @retval Fence of the job
+  */
+uint32_t BSP_DMA2D_BlendColor(uint32_t Alpha, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t DstOffLine, uint32_t ColorMode,
+                              uint32_t Color)
+{
+  DMA2D_JobTypeDef job = {0};
+
+  job.Mode            = DMA2D_M2M_BLEND;
+  job.Width           = xSize;
+  job.Height          = ySize;
+  job.OutputAddress   = Dst;
+  job.OutputOffset    = DstOffLine;
+  job.OutputColorMode = ColorMode;
+  job.FgAddress       = Alpha;
+  job.FgOffset        = 0;
+  job.FgColorMode     = CM_A8;
+  job.FgAlphaMode     = DMA2D_NO_MODIF_ALPHA;
+  job.FgColor         = Color;
+  job.BgAddress       = Dst;
+  job.BgOffset        = DstOffLine;
+  job.BgColorMode     = ColorMode;
+
+  return BSP_DMA2D_Submit(&job);
+}
+
+/*******************************************************************************
+                            Static Functions
+*******************************************************************************/
+
+/**
+  * @brief  Programs a job and starts the transfer; only registers that changed are written.
+  * @param  pJob: the job
+  */
+static void StartJob(const DMA2D_JobTypeDef *pJob)
+{
+  uint32_t cr = pJob->Mode | DMA2D_IRQ_ENABLES;
+  uint32_t fgpfccr = pJob->FgColorMode | (pJob->FgAlphaMode << DMA2D_AM_POSITION) | (pJob->FgColor & 0xFF000000);
+  uint32_t bgpfccr = pJob->BgColorMode | (DMA2D_NO_MODIF_ALPHA << DMA2D_AM_POSITION) | 0xFF000000;
+
+#define DMA2D_UPDATE(REG, VALUE)                            \
+  if (!ShadowValid || (Shadow.REG != (VALUE)))              \
+  {                                                         \
+    Shadow.REG = (VALUE);                                   \
+    DMA2D->REG = (VALUE);                                   \
+  }
+
+  DMA2D_UPDATE(CR, cr);
+  DMA2D_UPDATE(OPFCCR, pJob->OutputColorMode);
+  DMA2D_UPDATE(OOR, pJob->OutputOffset);
+  if (pJob->Mode == DMA2D_R2M)
+  {
+    DMA2D_UPDATE(OCOLR, pJob->OutputColor);
+  }
+  else
+  {
+    DMA2D->FGMAR = pJob->FgAddress;
+    DMA2D_UPDATE(FGOR, pJob->FgOffset);
+    DMA2D_UPDATE(FGPFCCR, fgpfccr);
+    if ((pJob->FgColorMode == CM_A8) || (pJob->FgColorMode == CM_A4))
+    {
+      DMA2D_UPDATE(FGCOLR, pJob->FgColor & 0x00FFFFFF);
+    }
+    if (pJob->Mode == DMA2D_M2M_BLEND)
+    {
+      DMA2D->BGMAR = pJob->BgAddress;
+      DMA2D_UPDATE(BGOR, pJob->BgOffset);
+      DMA2D_UPDATE(BGPFCCR, bgpfccr);
+    }
+  }
+  ShadowValid = 1;
+
+#undef DMA2D_UPDATE
+
+  DMA2D->OMAR = pJob->OutputAddress;
+  DMA2D->NLR = (pJob->Width << DMA2D_PL_POSITION) | pJob->Height;
+  DMA2D->CR = cr | DMA2D_CR_START;
+}
+
+/**
+  * @brief  Sleeps until the next job retires, or at most a tick. Polls when the
+  *         caller cannot block (interrupt context, or the kernel not running).
+  */
+static void WaitForRetire(void)
+{
+  // Added for mbed
+  if ((DoneFlags != NULL) && (__get_IPSR() == 0) && (osKernelGetState() == osKernelRunning))
+  {
+    osEventFlagsWait(DoneFlags, DMA2D_DONE_FLAG, osFlagsWaitAny, DMA2D_WAIT_TICKS);
+  }
+}
+
+/**
+  * @brief  This function handles the DMA2D interrupt: retires the finished job
+  *         and chains the next one.
+  */
+static void DMA2D_IRQHandler_Queue(void)
+{
+  uint32_t flags = DMA2D->ISR & DMA2D_IRQ_FLAGS;
+
+  if (flags == 0)
+  {
+    return;
+  }
+  DMA2D->IFCR = flags;
+
+  /* A failed transfer is retired like a finished one so waiters never hang */
+  Completed = Completed + 1;
+  if (Completed != Submitted)
+  {
+    StartJob(&Queue[(Completed + 1) % DMA2D_QUEUE_DEPTH]);
+  }
+  else
+  {
+    Running = 0;
+  }
+
+  // Added for mbed
+  if (DoneFlags != NULL)
+  {
+    osEventFlagsSet(DoneFlags, DMA2D_DONE_FLAG);
+  }
+}
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,117 @@
+/**
+  ******************************************************************************
+  * @file    stm32f429i_discovery_dma2d.h
+  * @brief   This file contains the common defines and functions prototypes for
+  *          the stm32f429i_discovery_dma2d.c driver.
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __STM32F429I_DISCOVERY_DMA2D_H
+#define __STM32F429I_DISCOVERY_DMA2D_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f429i_discovery.h"
+
+/** @addtogroup BSP
+  * @{
+  */
+
+/** @addtogroup STM32F429I_DISCOVERY
+  * @{
+  */
+
+/** @addtogroup STM32F429I_DISCOVERY_DMA2D
+  * @{
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Exported_Types STM32F429I DISCOVERY DMA2D Exported Types
+  * @{
+  */
+
+/**
+  * @brief  One 2D transfer. Mode is DMA2D_R2M, DMA2D_M2M, DMA2D_M2M_PFC or
+  *         DMA2D_M2M_BLEND; the layers a mode does not read are ignored.
+  */
+typedef struct
+{
+  uint32_t Mode;              /* Transfer mode */
+  uint32_t Width;             /* Pixels per line */
+  uint32_t Height;            /* Number of lines */
+
+  uint32_t OutputAddress;     /* First output pixel */
+  uint32_t OutputOffset;      /* Pixels skipped after each output line */
+  uint32_t OutputColorMode;   /* DMA2D_ARGB8888, DMA2D_RGB565, ... */
+  uint32_t OutputColor;       /* Fill color in the output format (R2M only) */
+
+  uint32_t FgAddress;         /* Foreground (source) first pixel */
+  uint32_t FgOffset;          /* Pixels skipped after each foreground line */
+  uint32_t FgColorMode;       /* CM_ARGB8888, CM_A8, ... */
+  uint32_t FgAlphaMode;       /* DMA2D_NO_MODIF_ALPHA, DMA2D_REPLACE_ALPHA, DMA2D_COMBINE_ALPHA */
+  uint32_t FgColor;           /* Alpha for the alpha mode, RGB for A4/A8 sources */
+
+  uint32_t BgAddress;         /* Background first pixel (M2M_BLEND only) */
+  uint32_t BgOffset;          /* Pixels skipped after each background line */
+  uint32_t BgColorMode;       /* Background color mode */
+} DMA2D_JobTypeDef;
+
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Exported_Constants STM32F429I DISCOVERY DMA2D Exported Constants
+  * @{
+  */
+
+/* Jobs the queue holds before BSP_DMA2D_Submit() has to wait for a free slot */
+#define DMA2D_QUEUE_DEPTH         16
+
+/* Priority of the transfer complete interrupt */
+#define DMA2D_IRQ_PREPRIO         0x0F
+
+/**
+  * @}
+  */
+
+/** @defgroup STM32F429I_DISCOVERY_DMA2D_Exported_Functions STM32F429I DISCOVERY DMA2D Exported Functions
+  * @{
+  */
+void     BSP_DMA2D_Init(void);
+uint32_t BSP_DMA2D_Submit(const DMA2D_JobTypeDef *pJob);
+uint32_t BSP_DMA2D_GetFence(void);
+uint8_t  BSP_DMA2D_IsDone(uint32_t Fence);
+void     BSP_DMA2D_Wait(uint32_t Fence);
+void     BSP_DMA2D_WaitIdle(void);
+
+uint32_t BSP_DMA2D_Fill(uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorMode, uint32_t Color);
+uint32_t BSP_DMA2D_Copy(uint32_t Src, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t SrcOffLine, uint32_t DstOffLine, uint32_t ColorMode);
+uint32_t BSP_DMA2D_Convert(uint32_t Src, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t SrcOffLine, uint32_t DstOffLine,
+                           uint32_t SrcColorMode, uint32_t DstColorMode);
+uint32_t BSP_DMA2D_BlendColor(uint32_t Alpha, uint32_t Dst, uint32_t xSize, uint32_t ySize, uint32_t DstOffLine, uint32_t ColorMode,
+                              uint32_t Color);
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM32F429I_DISCOVERY_DMA2D_H */
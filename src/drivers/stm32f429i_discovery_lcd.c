@@ -73,7 +73,11 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f429i_discovery_lcd.h"
+#include "stm32f429i_discovery_dma2d.h"
 #include "fonts.h"
+#include <string.h>
+#include "cmsis_nvic.h" // Added for mbed
+#include "cmsis_os2.h"  // Added for mbed
 //#include "font24.c"
 //#include "font20.c"
 //#include "font16.c"
@@ -96,6 +100,17 @@
 /** @defgroup STM32F429I_DISCOVERY_LCD_Private_TypesDefinitions STM32F429I DISCOVERY LCD Private TypesDefinitions
   * @{
   */ 
+typedef struct
+{
+  sFONT    *pFont;
+  uint8_t  *pData;   /* One Width x Height A8 image per glyph, in character order */
+}LCD_GlyphAtlasTypeDef;
+
+typedef struct
+{
+  uint32_t X0, Y0;   /* Top left corner */
+  uint32_t X1, Y1;   /* Bottom right corner, exclusive; empty if X1 <= X0 */
+}LCD_RectTypeDef;
 /**
   * @}
   */ 
@@ -105,6 +120,13 @@
   */
 #define POLY_X(Z)              ((int32_t)((Points + Z)->X))
 #define POLY_Y(Z)              ((int32_t)((Points + Z)->Y))
+#define GLYPH_COUNT            ('~' - ' ' + 1)
+#define GLYPH_ATLAS_FONTS      5
+
+/* Event flag raised by the register reload interrupt once a flip has latched.
+   The wait re-checks SRCR, so the timeout only bounds a missed wake-up. */
+#define LCD_FLIP_FLAG          0x00000001U
+#define LCD_FLIP_WAIT_TICKS    20
 /**
   * @}
   */ 
@@ -121,13 +143,25 @@
   * @{
   */ 
 LTDC_HandleTypeDef  LtdcHandler;
-static DMA2D_HandleTypeDef Dma2dHandler;
 static RCC_PeriphCLKInitTypeDef  PeriphClkInitStruct;
 
 /* Default LCD configuration with LCD Layer 1 */
 static uint32_t ActiveLayer = 0;
 static LCD_DrawPropTypeDef DrawProp[MAX_LAYER_NUMBER];
 LCD_DrvTypeDef  *LcdDrv;
+
+/* Glyph atlases, built in SDRAM the first time each font is drawn */
+static LCD_GlyphAtlasTypeDef GlyphAtlas[GLYPH_ATLAS_FONTS];
+static uint32_t GlyphAtlasCount = 0;
+static uint32_t GlyphAtlasUsed = 0;
+
+/* Per layer buffer drawn into; with double buffering it is not the one scanned out */
+static uint32_t DrawBuffer[MAX_LAYER_NUMBER];
+static uint8_t  DoubleBuffered[MAX_LAYER_NUMBER];
+static uint8_t  FlipPending[MAX_LAYER_NUMBER];
+static LCD_RectTypeDef Dirty[MAX_LAYER_NUMBER];   /* Drawn since the last flip */
+static LCD_RectTypeDef Stale[MAX_LAYER_NUMBER];   /* To copy into the back buffer once the flip lands */
+static osEventFlagsId_t FlipFlags = NULL;         /* Set from the reload interrupt, waited on by threads */
 /**
   * @}
   */ 
@@ -136,8 +170,17 @@ LCD_DrvTypeDef  *LcdDrv;
   * @{
   */ 
 static void DrawChar(uint16_t Xpos, uint16_t Ypos, const uint8_t *c);
+static void DrawString(uint16_t Xpos, uint16_t Ypos, const uint8_t *pText, uint32_t Count);
+static uint8_t *GetGlyphAtlas(sFONT *pFont);
+static void PrepareDraw(uint32_t LayerIndex);
+static void MarkDirty(uint32_t Xpos, uint32_t Ypos, uint32_t Width, uint32_t Height);
 static void FillBuffer(uint32_t LayerIndex, void *pDst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorIndex);
-static void ConvertLineToARGB8888(void *pSrc, void *pDst, uint32_t xSize, uint32_t ColorMode);
+static void ConvertLine(void *pSrc, void *pDst, uint32_t xSize, uint32_t ColorMode);
+static void LTDC_IRQHandler_Reload(void);
+static uint32_t LayerBytesPerPixel(uint32_t LayerIndex);
+static uint32_t PixelAddress(uint32_t LayerIndex, uint32_t Address, uint32_t Xpos, uint32_t Ypos);
+static uint32_t ConvertColor(uint32_t LayerIndex, uint32_t Color);
+static void LoadDefaultCLUT(uint32_t LayerIndex);
 /**
   * @}
   */ 
@@ -222,6 +265,22 @@ uint8_t BSP_LCD_Init(void)
 
     /* Initialize the SDRAM */
     BSP_SDRAM_Init();
+    /* Initialize the DMA2D job queue */
+    BSP_DMA2D_Init();
+
+    // Added for mbed
+    if (FlipFlags == NULL)
+    {
+      FlipFlags = osEventFlagsNew(NULL);
+    }
+
+    // Added for mbed
+    IRQn_Type irqn = LTDC_IRQn;
+    NVIC_ClearPendingIRQ(irqn);
+    NVIC_DisableIRQ(irqn);
+    NVIC_SetPriority(irqn, DMA2D_IRQ_PREPRIO);
+    NVIC_SetVector(irqn, (uint32_t)LTDC_IRQHandler_Reload);
+    NVIC_EnableIRQ(irqn);
 
     /* Initialize the font */
     BSP_LCD_SetFont(&LCD_DEFAULT_FONT);
@@ -253,6 +312,18 @@ uint32_t BSP_LCD_GetYSize(void)
   * @param  FB_Address: the layer frame buffer.
   */
 void BSP_LCD_LayerDefaultInit(uint16_t LayerIndex, uint32_t FB_Address)
+{     
+  BSP_LCD_LayerInit(LayerIndex, FB_Address, LCD_PIXEL_FORMAT_ARGB8888);
+}
+
+/**
+  * @brief  Initializes an LCD layer with a given pixel format.
+  * @param  LayerIndex: the layer foreground or background. 
+  * @param  FB_Address: the layer frame buffer.
+  * @param  PixelFormat: LCD_PIXEL_FORMAT_ARGB8888, LCD_PIXEL_FORMAT_RGB565 or
+  *         LCD_PIXEL_FORMAT_L8 (with an RGB332 color look-up table)
+  */
+void BSP_LCD_LayerInit(uint16_t LayerIndex, uint32_t FB_Address, uint32_t PixelFormat)
 {     
   LCD_LayerCfgTypeDef   Layercfg;
 
@@ -261,7 +332,7 @@ void BSP_LCD_LayerDefaultInit(uint16_t LayerIndex, uint32_t FB_Address)
   Layercfg.WindowX1 = BSP_LCD_GetXSize();
   Layercfg.WindowY0 = 0;
   Layercfg.WindowY1 = BSP_LCD_GetYSize(); 
-  Layercfg.PixelFormat = LTDC_PIXEL_FORMAT_ARGB8888;
+  Layercfg.PixelFormat = PixelFormat;
   Layercfg.FBStartAdress = FB_Address;
   Layercfg.Alpha = 255;
   Layercfg.Alpha0 = 0;
@@ -275,6 +346,15 @@ void BSP_LCD_LayerDefaultInit(uint16_t LayerIndex, uint32_t FB_Address)
   
   HAL_LTDC_ConfigLayer(&LtdcHandler, &Layercfg, LayerIndex); 
 
+  DrawBuffer[LayerIndex] = FB_Address;
+  DoubleBuffered[LayerIndex] = 0;
+  FlipPending[LayerIndex] = 0;
+
+  if(PixelFormat == LCD_PIXEL_FORMAT_L8)
+  {
+    LoadDefaultCLUT(LayerIndex);
+  }
+
   DrawProp[LayerIndex].BackColor = LCD_COLOR_WHITE;
   DrawProp[LayerIndex].pFont     = &Font24;
   DrawProp[LayerIndex].TextColor = LCD_COLOR_BLACK; 
@@ -364,6 +444,8 @@ void BSP_LCD_SetTransparency_NoReload(uint32_t LayerIndex, uint8_t Transparency)
 void BSP_LCD_SetLayerAddress(uint32_t LayerIndex, uint32_t Address)
 {     
   HAL_LTDC_SetAddress(&LtdcHandler, Address, LayerIndex);
+  DrawBuffer[LayerIndex] = Address;
+  DoubleBuffered[LayerIndex] = 0;
 }
 
 /**
@@ -375,6 +457,121 @@ void BSP_LCD_SetLayerAddress(uint32_t LayerIndex, uint32_t Address)
 void BSP_LCD_SetLayerAddress_NoReload(uint32_t LayerIndex, uint32_t Address)
 {
   HAL_LTDC_SetAddress_NoReload(&LtdcHandler, Address, LayerIndex);
+  DrawBuffer[LayerIndex] = Address;
+  DoubleBuffered[LayerIndex] = 0;
+}
+
+/**
+  * @brief  Switches the pixel format of a layer; redraw it afterwards.
+  * @param  LayerIndex: Layer foreground or background
+  * @param  PixelFormat: LCD_PIXEL_FORMAT_ARGB8888, LCD_PIXEL_FORMAT_RGB565 or
+  *         LCD_PIXEL_FORMAT_L8
+  */
+void BSP_LCD_SetPixelFormat(uint32_t LayerIndex, uint32_t PixelFormat)
+{
+  BSP_DMA2D_WaitIdle();
+  HAL_LTDC_SetPixelFormat(&LtdcHandler, PixelFormat, LayerIndex);
+  if(PixelFormat == LCD_PIXEL_FORMAT_L8)
+  {
+    LoadDefaultCLUT(LayerIndex);
+  }
+}
+
+/**
+  * @brief  Gives a layer a back buffer, BUFFER_OFFSET above its frame buffer.
+  *         Drawing then goes to the back buffer until BSP_LCD_SwapBuffers().
+  * @param  LayerIndex: Layer foreground or background
+  */
+void BSP_LCD_EnableDoubleBuffer(uint32_t LayerIndex)
+{
+  uint32_t front = LtdcHandler.LayerCfg[LayerIndex].FBStartAdress;
+
+  if(DoubleBuffered[LayerIndex])
+  {
+    return;
+  }
+
+  /* Start the back buffer from what is on screen */
+  DrawBuffer[LayerIndex] = front + BUFFER_OFFSET;
+  BSP_DMA2D_Copy(front, DrawBuffer[LayerIndex], BSP_LCD_GetXSize(), BSP_LCD_GetYSize(), 0, 0,
+                 LtdcHandler.LayerCfg[LayerIndex].PixelFormat);
+
+  DoubleBuffered[LayerIndex] = 1;
+  FlipPending[LayerIndex] = 0;
+  Dirty[LayerIndex].X1 = 0;
+}
+
+/**
+  * @brief  Shows the back buffer of a layer from the next vertical blanking on.
+  *         Returns at once; drawing into the layer waits for the flip to land.
+  * @param  LayerIndex: Layer foreground or background
+  */
+void BSP_LCD_SwapBuffers(uint32_t LayerIndex)
+{
+  uint32_t front = LtdcHandler.LayerCfg[LayerIndex].FBStartAdress;
+
+  if(!DoubleBuffered[LayerIndex] || (Dirty[LayerIndex].X1 <= Dirty[LayerIndex].X0))
+  {
+    return;
+  }
+
+  /* Finish the previous flip and everything queued for this frame */
+  PrepareDraw(LayerIndex);
+  BSP_DMA2D_WaitIdle();
+
+  HAL_LTDC_SetAddress_NoReload(&LtdcHandler, DrawBuffer[LayerIndex], LayerIndex);
+
+  /* Have the reload raise an interrupt once it has latched */
+  if (FlipFlags != NULL)
+  {
+    osEventFlagsClear(FlipFlags, LCD_FLIP_FLAG);
+  }
+  LTDC->ICR = LTDC_ICR_CRRIF;
+  __HAL_LTDC_ENABLE_IT(&LtdcHandler, LTDC_IT_RR);
+  BSP_LCD_Relaod(LCD_RELOAD_VERTICAL_BLANKING);
+
+  /* The old front buffer misses what was drawn this frame */
+  DrawBuffer[LayerIndex] = front;
+  Stale[LayerIndex] = Dirty[LayerIndex];
+  Dirty[LayerIndex].X1 = 0;
+  FlipPending[LayerIndex] = 1;
+}
+
+/**
+  * @brief  Waits until a requested buffer swap has been latched by the LTDC.
+  *         Sleeps on the reload interrupt; polls when the caller cannot block
+  *         (interrupt context, or the kernel not running).
+  */
+void BSP_LCD_WaitForFlip(void)
+{
+  while(LTDC->SRCR & LTDC_SRCR_VBR)
+  {
+    // Added for mbed
+    if ((FlipFlags != NULL) && (__get_IPSR() == 0) && (osKernelGetState() == osKernelRunning))
+    {
+      osEventFlagsWait(FlipFlags, LCD_FLIP_FLAG, osFlagsWaitAny, LCD_FLIP_WAIT_TICKS);
+    }
+  }
+}
+
+/**
+  * @brief  This function handles the LTDC interrupt: signals that a requested
+  *         register reload has latched.
+  */
+static void LTDC_IRQHandler_Reload(void)
+{
+  if ((LTDC->ISR & LTDC_ISR_RRIF) == 0)
+  {
+    return;
+  }
+  LTDC->ICR = LTDC_ICR_CRRIF;
+  __HAL_LTDC_DISABLE_IT(&LtdcHandler, LTDC_IT_RR);
+
+  // Added for mbed
+  if (FlipFlags != NULL)
+  {
+    osEventFlagsSet(FlipFlags, LCD_FLIP_FLAG);
+  }
 }
 
 /**
@@ -533,28 +730,30 @@ sFONT *BSP_LCD_GetFont(void)
 uint32_t BSP_LCD_ReadPixel(uint16_t Xpos, uint16_t Ypos)
 {
   uint32_t ret = 0;
+  uint32_t address = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
   
-  if(LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LTDC_PIXEL_FORMAT_ARGB8888)
+  /* Let queued DMA2D jobs land first */
+  PrepareDraw(ActiveLayer);
+  BSP_DMA2D_WaitIdle();
+
+  switch(LayerBytesPerPixel(ActiveLayer))
   {
+  case 4:
     /* Read data value from SDRAM memory */
-    ret = *(__IO uint32_t*) (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (4*(Ypos*BSP_LCD_GetXSize() + Xpos)));
-  }
-  else if(LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LTDC_PIXEL_FORMAT_RGB888)
-  {
+    ret = *(__IO uint32_t*) (address);
+    break;
+  case 3:
     /* Read data value from SDRAM memory */
-    ret = (*(__IO uint32_t*) (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (4*(Ypos*BSP_LCD_GetXSize() + Xpos))) & 0x00FFFFFF);
-  }
-  else if((LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LTDC_PIXEL_FORMAT_RGB565) || \
-          (LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LTDC_PIXEL_FORMAT_ARGB4444) || \
-          (LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LTDC_PIXEL_FORMAT_AL88))  
-  {
+    ret = (*(__IO uint8_t*) (address)) | (*(__IO uint8_t*) (address + 1) << 8) | (*(__IO uint8_t*) (address + 2) << 16);
+    break;
+  case 2:
     /* Read data value from SDRAM memory */
-    ret = *(__IO uint16_t*) (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (2*(Ypos*BSP_LCD_GetXSize() + Xpos)));    
-  }
-  else
-  {
+    ret = *(__IO uint16_t*) (address);    
+    break;
+  default:
     /* Read data value from SDRAM memory */
-    ret = *(__IO uint8_t*) (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (2*(Ypos*BSP_LCD_GetXSize() + Xpos)));    
+    ret = *(__IO uint8_t*) (address);    
+    break;
   }
 
   return ret;
@@ -567,7 +766,8 @@ uint32_t BSP_LCD_ReadPixel(uint16_t Xpos, uint16_t Ypos)
 void BSP_LCD_Clear(uint32_t Color)
 { 
   /* Clear the LCD */ 
-  FillBuffer(ActiveLayer, (uint32_t *)(LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress), BSP_LCD_GetXSize(), BSP_LCD_GetYSize(), 0, Color);
+  MarkDirty(0, 0, BSP_LCD_GetXSize(), BSP_LCD_GetYSize());
+  FillBuffer(ActiveLayer, (uint32_t *)(DrawBuffer[ActiveLayer]), BSP_LCD_GetXSize(), BSP_LCD_GetYSize(), 0, Color);
 }
 
 /**
@@ -594,8 +794,7 @@ void BSP_LCD_ClearStringLine(uint32_t Line)
   */
 void BSP_LCD_DisplayChar(uint16_t Xpos, uint16_t Ypos, uint8_t Ascii)
 {
-  DrawChar(Xpos, Ypos, &DrawProp[ActiveLayer].pFont->table[(Ascii-' ') *\
-              DrawProp[ActiveLayer].pFont->Height * ((DrawProp[ActiveLayer].pFont->Width + 7) / 8)]);
+  DrawString(Xpos, Ypos, &Ascii, 1);
 }
 
 /**
@@ -645,17 +844,9 @@ void BSP_LCD_DisplayStringAt(uint16_t X, uint16_t Y, uint8_t *pText, Text_AlignM
     }
   }
 
-  /* Send the string character by character on LCD */
-  while ((*pText != 0) & (((BSP_LCD_GetXSize() - (i*DrawProp[ActiveLayer].pFont->Width)) & 0xFFFF) >= DrawProp[ActiveLayer].pFont->Width))
-  {
-    /* Display one character on LCD */
-    BSP_LCD_DisplayChar(refcolumn, Y, *pText);
-    /* Decrement the column position by 16 */
-    refcolumn += DrawProp[ActiveLayer].pFont->Width;
-    /* Point on the next character */
-    pText++;
-    i++;
-  }  
+  /* Send the characters that fit on a line to the LCD in one run */
+  i = (size < xsize) ? size : xsize;
+  DrawString(refcolumn, Y, pText, i);
 }
 
 /**
@@ -679,7 +870,8 @@ void BSP_LCD_DrawHLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length)
   uint32_t xaddress = 0;
   
   /* Get the line address */
-  xaddress = (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress) + 4*(BSP_LCD_GetXSize()*Ypos + Xpos);
+  MarkDirty(Xpos, Ypos, Length, 1);
+  xaddress = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
 
   /* Write line */
   FillBuffer(ActiveLayer, (uint32_t *)xaddress, Length, 1, 0, DrawProp[ActiveLayer].TextColor);
@@ -696,7 +888,8 @@ void BSP_LCD_DrawVLine(uint16_t Xpos, uint16_t Ypos, uint16_t Length)
   uint32_t xaddress = 0;
   
   /* Get the line address */
-  xaddress = (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress) + 4*(BSP_LCD_GetXSize()*Ypos + Xpos);
+  MarkDirty(Xpos, Ypos, 1, Length);
+  xaddress = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
   
   /* Write line */
   FillBuffer(ActiveLayer, (uint32_t *)xaddress, 1, Length, (BSP_LCD_GetXSize() - 1), DrawProp[ActiveLayer].TextColor);
@@ -917,7 +1110,8 @@ void BSP_LCD_DrawBitmap(uint32_t X, uint32_t Y, uint8_t *pBmp)
   bitpixel = pBmp[28] + (pBmp[29] << 8);   
  
   /* Set Address */
-  address = LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (((BSP_LCD_GetXSize()*Y) + X)*(4));
+  MarkDirty(X, Y, width, height);
+  address = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], X, Y);
 
   /* Get the Layer pixel format */    
   if ((bitpixel/8) == 4)
@@ -936,18 +1130,47 @@ void BSP_LCD_DrawBitmap(uint32_t X, uint32_t Y, uint8_t *pBmp)
   /* bypass the bitmap header */
   pBmp += (index + (width * (height - 1) * (bitpixel/8)));
 
-  /* Convert picture to ARGB8888 pixel format */
+  /* Convert picture to the layer pixel format */
   for(index=0; index < height; index++)
   {
   /* Pixel format conversion */
-  ConvertLineToARGB8888((uint32_t *)pBmp, (uint32_t *)address, width, inputcolormode);
+  ConvertLine((uint32_t *)pBmp, (uint32_t *)address, width, inputcolormode);
 
   /* Increment the source and destination buffers */
-  address+=  ((BSP_LCD_GetXSize() - width + width)*4);
+  address+=  (BSP_LCD_GetXSize()*LayerBytesPerPixel(ActiveLayer));
   pBmp -= width*(bitpixel/8);
   }
 }
 
+/**
+  * @brief  Copies whole lines of the active layer to memory, in the layer pixel format.
+  * @param  Ypos: first line
+  * @param  Height: number of lines
+  * @param  Dst: destination, holding BSP_LCD_GetXSize() pixels per line
+  */
+void BSP_LCD_SaveLines(uint16_t Ypos, uint16_t Height, uint32_t Dst)
+{
+  PrepareDraw(ActiveLayer);
+  BSP_DMA2D_Copy(PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], 0, Ypos), Dst, BSP_LCD_GetXSize(), Height, 0, 0,
+                 LtdcHandler.LayerCfg[ActiveLayer].PixelFormat);
+}
+
+/**
+  * @brief  Copies a span of lines saved by BSP_LCD_SaveLines() back in place.
+  * @param  Xpos: first column of the span
+  * @param  Ypos: first line, as saved
+  * @param  Width: span width
+  * @param  Height: number of lines
+  * @param  Src: the saved lines
+  */
+void BSP_LCD_RestoreLines(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Src)
+{
+  MarkDirty(Xpos, Ypos, Width, Height);
+  BSP_DMA2D_Copy(PixelAddress(ActiveLayer, Src, Xpos, 0), PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos),
+                 Width, Height, (BSP_LCD_GetXSize() - Width), (BSP_LCD_GetXSize() - Width),
+                 LtdcHandler.LayerCfg[ActiveLayer].PixelFormat);
+}
+
 /**
   * @brief  Displays a full rectangle.
   * @param  Xpos: the X position
@@ -963,7 +1186,8 @@ void BSP_LCD_FillRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Hei
   BSP_LCD_SetTextColor(DrawProp[ActiveLayer].TextColor);
 
   /* Get the rectangle start address */
-  xaddress = (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress) + 4*(BSP_LCD_GetXSize()*Ypos + Xpos);
+  MarkDirty(Xpos, Ypos, Width, Height);
+  xaddress = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
 
   /* Fill the rectangle */
   FillBuffer(ActiveLayer, (uint32_t *)xaddress, Width, Height, (BSP_LCD_GetXSize() - Width), DrawProp[ActiveLayer].TextColor);
@@ -1307,8 +1531,32 @@ __weak void BSP_LCD_MspInit(void)
   */
 void BSP_LCD_DrawPixel(uint16_t Xpos, uint16_t Ypos, uint32_t RGB_Code)
 {
+  uint32_t address;
+
+  /* Let queued DMA2D jobs land first */
+  MarkDirty(Xpos, Ypos, 1, 1);
+  BSP_DMA2D_WaitIdle();
+
   /* Write data value to all SDRAM memory */
-  *(__IO uint32_t*) (LtdcHandler.LayerCfg[ActiveLayer].FBStartAdress + (4*(Ypos*BSP_LCD_GetXSize() + Xpos))) = RGB_Code;
+  address = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
+  RGB_Code = ConvertColor(ActiveLayer, RGB_Code);
+  switch(LayerBytesPerPixel(ActiveLayer))
+  {
+  case 4:
+    *(__IO uint32_t*) (address) = RGB_Code;
+    break;
+  case 3:
+    *(__IO uint8_t*) (address) = RGB_Code;
+    *(__IO uint8_t*) (address + 1) = RGB_Code >> 8;
+    *(__IO uint8_t*) (address + 2) = RGB_Code >> 16;
+    break;
+  case 2:
+    *(__IO uint16_t*) (address) = RGB_Code;
+    break;
+  default:
+    *(__IO uint8_t*) (address) = RGB_Code;
+    break;
+  }
 }
 
 /**
@@ -1365,6 +1613,194 @@ static void DrawChar(uint16_t Xpos, uint16_t Ypos, const uint8_t *c)
   }
 }
 
+/**
+  * @brief  Draws a run of characters on LCD.
+  * @param  Xpos: start column address
+  * @param  Ypos: the Line where to display the characters
+  * @param  pText: pointer to the characters, between 0x20 and 0x7E
+  * @param  Count: number of characters to draw
+  */
+static void DrawString(uint16_t Xpos, uint16_t Ypos, const uint8_t *pText, uint32_t Count)
+{
+  sFONT *font = DrawProp[ActiveLayer].pFont;
+  uint8_t *atlas = GetGlyphAtlas(font);
+  uint32_t glyphsize = font->Width * font->Height;
+  uint32_t bpp = LayerBytesPerPixel(ActiveLayer);
+  uint32_t xaddress = 0, i = 0, j = 0, color = 0;
+  const uint8_t *pglyph;
+  uint8_t *pdst;
+
+  if(atlas == NULL)
+  {
+    /* No room left for the atlas: draw pixel by pixel */
+    for(i = 0; i < Count; i++)
+    {
+      DrawChar(Xpos + i * font->Width, Ypos, &font->table[(pText[i]-' ') * font->Height * ((font->Width + 7) / 8)]);
+    }
+    return;
+  }
+
+  /* Get the run start address */
+  MarkDirty(Xpos, Ypos, Count * font->Width, font->Height);
+  xaddress = PixelAddress(ActiveLayer, DrawBuffer[ActiveLayer], Xpos, Ypos);
+
+  /* Paint the background of the whole run, then blend each glyph over it in the text color */
+  FillBuffer(ActiveLayer, (uint32_t *)xaddress, Count * font->Width, font->Height, (BSP_LCD_GetXSize() - Count * font->Width), DrawProp[ActiveLayer].BackColor);
+  if(LtdcHandler.LayerCfg[ActiveLayer].PixelFormat == LCD_PIXEL_FORMAT_L8)
+  {
+    /* The DMA2D cannot write L8: set the glyph pixels from the CPU */
+    color = ConvertColor(ActiveLayer, DrawProp[ActiveLayer].TextColor);
+    BSP_DMA2D_WaitIdle();
+    for(i = 0; i < Count; i++)
+    {
+      pglyph = atlas + (pText[i]-' ') * glyphsize;
+      pdst = (uint8_t *)(xaddress + i * font->Width);
+      for(j = 0; j < glyphsize; j++)
+      {
+        if(pglyph[j])
+        {
+          pdst[(j / font->Width) * BSP_LCD_GetXSize() + (j % font->Width)] = color;
+        }
+      }
+    }
+    return;
+  }
+
+  for(i = 0; i < Count; i++)
+  {
+    BSP_DMA2D_BlendColor((uint32_t)(atlas + (pText[i]-' ') * glyphsize), xaddress + bpp * i * font->Width,
+                         font->Width, font->Height, (BSP_LCD_GetXSize() - font->Width),
+                         LtdcHandler.LayerCfg[ActiveLayer].PixelFormat, DrawProp[ActiveLayer].TextColor);
+  }
+}
+
+/**
+  * @brief  Completes a pending flip of a layer before its back buffer is used:
+  *         waits for the LTDC to latch it and queues the copy forward of the
+  *         region drawn in the frame now shown.
+  * @param  LayerIndex: layer index
+  */
+static void PrepareDraw(uint32_t LayerIndex)
+{
+  LCD_RectTypeDef *stale = &Stale[LayerIndex];
+
+  if(!FlipPending[LayerIndex])
+  {
+    return;
+  }
+
+  BSP_LCD_WaitForFlip();
+  FlipPending[LayerIndex] = 0;
+
+  BSP_DMA2D_Copy(PixelAddress(LayerIndex, LtdcHandler.LayerCfg[LayerIndex].FBStartAdress, stale->X0, stale->Y0),
+                 PixelAddress(LayerIndex, DrawBuffer[LayerIndex], stale->X0, stale->Y0),
+                 stale->X1 - stale->X0, stale->Y1 - stale->Y0,
+                 BSP_LCD_GetXSize() - (stale->X1 - stale->X0), BSP_LCD_GetXSize() - (stale->X1 - stale->X0),
+                 LtdcHandler.LayerCfg[LayerIndex].PixelFormat);
+}
+
+/**
+  * @brief  Readies the active layer for drawing into a rectangle and, with
+  *         double buffering, adds the rectangle to the region drawn this frame.
+  * @param  Xpos: the X position
+  * @param  Ypos: the Y position
+  * @param  Width: rectangle width
+  * @param  Height: rectangle height
+  */
+static void MarkDirty(uint32_t Xpos, uint32_t Ypos, uint32_t Width, uint32_t Height)
+{
+  LCD_RectTypeDef *dirty = &Dirty[ActiveLayer];
+  uint32_t x1 = Xpos + Width, y1 = Ypos + Height;
+
+  PrepareDraw(ActiveLayer);
+  if(!DoubleBuffered[ActiveLayer])
+  {
+    return;
+  }
+
+  x1 = (x1 < BSP_LCD_GetXSize()) ? x1 : BSP_LCD_GetXSize();
+  y1 = (y1 < BSP_LCD_GetYSize()) ? y1 : BSP_LCD_GetYSize();
+  if((x1 <= Xpos) || (y1 <= Ypos))
+  {
+    return;
+  }
+
+  if(dirty->X1 <= dirty->X0)
+  {
+    dirty->X0 = Xpos;
+    dirty->Y0 = Ypos;
+    dirty->X1 = x1;
+    dirty->Y1 = y1;
+    return;
+  }
+  dirty->X0 = (Xpos < dirty->X0) ? Xpos : dirty->X0;
+  dirty->Y0 = (Ypos < dirty->Y0) ? Ypos : dirty->Y0;
+  dirty->X1 = (x1 > dirty->X1) ? x1 : dirty->X1;
+  dirty->Y1 = (y1 > dirty->Y1) ? y1 : dirty->Y1;
+}
+
+/**
+  * @brief  Gets the glyph atlas of a font, rasterizing it into SDRAM on first use.
+  * @param  pFont: the font
+  * @retval Atlas start address, NULL if the atlas area is full
+  */
+static uint8_t *GetGlyphAtlas(sFONT *pFont)
+{
+  uint32_t i = 0, j = 0, k = 0, size = 0;
+  uint16_t height = pFont->Height, width = pFont->Width;
+  uint8_t offset = 8 *((width + 7)/8) - width;
+  const uint8_t *pchar;
+  uint8_t *pdst;
+  uint32_t line = 0;
+
+  for(i = 0; i < GlyphAtlasCount; i++)
+  {
+    if(GlyphAtlas[i].pFont == pFont)
+    {
+      return GlyphAtlas[i].pData;
+    }
+  }
+
+  size = GLYPH_COUNT * width * height;
+  if((GlyphAtlasCount == GLYPH_ATLAS_FONTS) || (GlyphAtlasUsed + size > LCD_GLYPH_ATLAS_SIZE))
+  {
+    return NULL;
+  }
+
+  /* Expand every 1 bpp glyph row into one alpha byte per pixel */
+  pdst = (uint8_t *)(LCD_GLYPH_ATLAS + GlyphAtlasUsed);
+  pchar = pFont->table;
+  for(k = 0; k < GLYPH_COUNT * height; k++)
+  {
+    switch(((width + 7)/8))
+    {
+    case 1:
+      line =  pchar[0];
+      break;
+
+    case 2:
+      line =  (pchar[0]<< 8) | pchar[1];
+      break;
+
+    case 3:
+    default:
+      line =  (pchar[0]<< 16) | (pchar[1]<< 8) | pchar[2];
+      break;
+    }
+    pchar += (width + 7)/8;
+
+    for (j = 0; j < width; j++)
+    {
+      *pdst++ = (line & (1 << (width- j + offset- 1))) ? 0xFF : 0x00;
+    }
+  }
+
+  GlyphAtlas[GlyphAtlasCount].pFont = pFont;
+  GlyphAtlas[GlyphAtlasCount].pData = (uint8_t *)(LCD_GLYPH_ATLAS + GlyphAtlasUsed);
+  GlyphAtlasUsed += size;
+  return GlyphAtlas[GlyphAtlasCount++].pData;
+}
+
 /**
   * @brief  Fills buffer.
   * @param  LayerIndex: layer index
@@ -1372,66 +1808,148 @@ static void DrawChar(uint16_t Xpos, uint16_t Ypos, const uint8_t *c)
   * @param  xSize: buffer width
   * @param  ySize: buffer height
   * @param  OffLine: offset
-  * @param  ColorIndex: color Index  
+  * @param  ColorIndex: color Index, ARGB(8-8-8-8)
   */
 static void FillBuffer(uint32_t LayerIndex, void * pDst, uint32_t xSize, uint32_t ySize, uint32_t OffLine, uint32_t ColorIndex) 
 {
-  
-  /* Register to memory mode with ARGB8888 as color Mode */ 
-  Dma2dHandler.Init.Mode         = DMA2D_R2M;
-  Dma2dHandler.Init.ColorMode    = DMA2D_ARGB8888;
-  Dma2dHandler.Init.OutputOffset = OffLine;      
-  
-  Dma2dHandler.Instance = DMA2D; 
-  
-  /* DMA2D Initialization */
-  if(HAL_DMA2D_Init(&Dma2dHandler) == HAL_OK) 
+  uint32_t format = LtdcHandler.LayerCfg[LayerIndex].PixelFormat;
+  uint32_t color = ConvertColor(LayerIndex, ColorIndex);
+  uint32_t i = 0;
+
+  if(format != LCD_PIXEL_FORMAT_L8)
+  {
+    /* Register to memory mode in the layer color mode, queued */
+    BSP_DMA2D_Fill((uint32_t)pDst, xSize, ySize, OffLine, format, color);
+  }
+  else if((((uint32_t)pDst | xSize | OffLine) & 1) == 0)
   {
-    if(HAL_DMA2D_ConfigLayer(&Dma2dHandler, LayerIndex) == HAL_OK) 
+    /* The DMA2D cannot write L8: fill pixel pairs as 16-bit pixels instead */
+    BSP_DMA2D_Fill((uint32_t)pDst, xSize / 2, ySize, OffLine / 2, DMA2D_RGB565, color | (color << 8));
+  }
+  else
+  {
+    BSP_DMA2D_WaitIdle();
+    for(i = 0; i < ySize; i++)
     {
-      if (HAL_DMA2D_Start(&Dma2dHandler, ColorIndex, (uint32_t)pDst, xSize, ySize) == HAL_OK)
-      {
-        /* Polling For DMA transfer */  
-        HAL_DMA2D_PollForTransfer(&Dma2dHandler, 10);
-      }
+      memset((uint8_t *)pDst + i * (xSize + OffLine), color, xSize);
     }
-  } 
+  }
 }
 
 /**
-  * @brief  Converts Line to ARGB8888 pixel format.
+  * @brief  Converts Line to the active layer pixel format.
   * @param  pSrc: pointer to source buffer
   * @param  pDst: output color
   * @param  xSize: buffer width
   * @param  ColorMode: input color mode   
   */
-static void ConvertLineToARGB8888(void * pSrc, void * pDst, uint32_t xSize, uint32_t ColorMode)
+static void ConvertLine(void * pSrc, void * pDst, uint32_t xSize, uint32_t ColorMode)
 {    
-  /* Configure the DMA2D Mode, Color Mode and output offset */
-  Dma2dHandler.Init.Mode         = DMA2D_M2M_PFC;
-  Dma2dHandler.Init.ColorMode    = DMA2D_ARGB8888;
-  Dma2dHandler.Init.OutputOffset = 0;     
-  
-  /* Foreground Configuration */
-  Dma2dHandler.LayerCfg[1].AlphaMode = DMA2D_NO_MODIF_ALPHA;
-  Dma2dHandler.LayerCfg[1].InputAlpha = 0xFF;
-  Dma2dHandler.LayerCfg[1].InputColorMode = ColorMode;
-  Dma2dHandler.LayerCfg[1].InputOffset = 0;
-  
-  Dma2dHandler.Instance = DMA2D; 
-  
-  /* DMA2D Initialization */
-  if(HAL_DMA2D_Init(&Dma2dHandler) == HAL_OK) 
+  uint8_t *psrc = (uint8_t *)pSrc;
+  uint32_t i = 0, color = 0;
+
+  if(LtdcHandler.LayerCfg[ActiveLayer].PixelFormat != LCD_PIXEL_FORMAT_L8)
+  {
+    /* Memory to memory with pixel format conversion, queued */
+    BSP_DMA2D_Convert((uint32_t)pSrc, (uint32_t)pDst, xSize, 1, 0, 0, ColorMode, LtdcHandler.LayerCfg[ActiveLayer].PixelFormat);
+    return;
+  }
+
+  /* The DMA2D cannot write L8: map each pixel to the palette from the CPU */
+  BSP_DMA2D_WaitIdle();
+  for(i = 0; i < xSize; i++)
   {
-    if(HAL_DMA2D_ConfigLayer(&Dma2dHandler, 1) == HAL_OK) 
+    if(ColorMode == CM_ARGB8888)
     {
-      if (HAL_DMA2D_Start(&Dma2dHandler, (uint32_t)pSrc, (uint32_t)pDst, xSize, 1) == HAL_OK)
-      {
-        /* Polling For DMA transfer */  
-        HAL_DMA2D_PollForTransfer(&Dma2dHandler, 10);
-      }
+      color = psrc[0] | (psrc[1] << 8) | (psrc[2] << 16);
+      psrc += 4;
     }
-  } 
+    else if(ColorMode == CM_RGB565)
+    {
+      color = psrc[0] | (psrc[1] << 8);
+      color = ((color & 0xF800) << 8) | ((color & 0x07E0) << 5) | ((color & 0x001F) << 3);
+      psrc += 2;
+    }
+    else
+    {
+      color = psrc[0] | (psrc[1] << 8) | (psrc[2] << 16);
+      psrc += 3;
+    }
+    ((uint8_t *)pDst)[i] = ConvertColor(ActiveLayer, color);
+  }
+}
+
+/**
+  * @brief  Gets the bytes per pixel of a layer.
+  * @param  LayerIndex: layer index
+  * @retval Bytes per pixel
+  */
+static uint32_t LayerBytesPerPixel(uint32_t LayerIndex)
+{
+  switch(LtdcHandler.LayerCfg[LayerIndex].PixelFormat)
+  {
+  case LCD_PIXEL_FORMAT_ARGB8888:
+    return 4;
+  case LCD_PIXEL_FORMAT_RGB888:
+    return 3;
+  case LCD_PIXEL_FORMAT_L8:
+  case LCD_PIXEL_FORMAT_AL44:
+    return 1;
+  default:
+    return 2;
+  }
+}
+
+/**
+  * @brief  Gets the address of a pixel in a frame buffer of a layer.
+  * @param  LayerIndex: layer index
+  * @param  Address: frame buffer start
+  * @param  Xpos: the X position
+  * @param  Ypos: the Y position
+  * @retval Pixel address
+  */
+static uint32_t PixelAddress(uint32_t LayerIndex, uint32_t Address, uint32_t Xpos, uint32_t Ypos)
+{
+  return Address + LayerBytesPerPixel(LayerIndex)*(BSP_LCD_GetXSize()*Ypos + Xpos);
+}
+
+/**
+  * @brief  Converts an ARGB(8-8-8-8) color to the pixel format of a layer.
+  * @param  LayerIndex: layer index
+  * @param  Color: the color
+  * @retval Pixel value
+  */
+static uint32_t ConvertColor(uint32_t LayerIndex, uint32_t Color)
+{
+  uint32_t red = (Color >> 16) & 0xFF, green = (Color >> 8) & 0xFF, blue = Color & 0xFF;
+
+  switch(LtdcHandler.LayerCfg[LayerIndex].PixelFormat)
+  {
+  case LCD_PIXEL_FORMAT_RGB565:
+    return ((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3);
+  case LCD_PIXEL_FORMAT_L8:
+    /* Index into the RGB332 palette loaded by LoadDefaultCLUT() */
+    return ((red >> 5) << 5) | ((green >> 5) << 2) | (blue >> 6);
+  default:
+    return Color;
+  }
+}
+
+/**
+  * @brief  Loads an RGB332 color look-up table for an L8 layer.
+  * @param  LayerIndex: layer index
+  */
+static void LoadDefaultCLUT(uint32_t LayerIndex)
+{
+  static uint32_t clut[256];
+  uint32_t i = 0;
+
+  for(i = 0; i < 256; i++)
+  {
+    clut[i] = ((((i >> 5) & 7) * 255 / 7) << 16) | ((((i >> 2) & 7) * 255 / 7) << 8) | ((i & 3) * 255 / 3);
+  }
+  HAL_LTDC_ConfigCLUT(&LtdcHandler, clut, 256, LayerIndex);
+  HAL_LTDC_EnableCLUT(&LtdcHandler, LayerIndex);
 }
 
 /**
@@ -110,6 +110,12 @@ typedef enum
 #define LCD_FRAME_BUFFER       ((uint32_t)0xD0000000)
 #define BUFFER_OFFSET          ((uint32_t)0x50000) 
 
+/** 
+  * @brief  SDRAM area holding the A8 glyph atlases rasterized from the fonts  
+  */
+#define LCD_GLYPH_ATLAS        ((uint32_t)0xD0700000)
+#define LCD_GLYPH_ATLAS_SIZE   ((uint32_t)0x100000)
+
 /** 
   * @brief  LCD color  
   */ 
@@ -187,6 +193,8 @@ uint32_t BSP_LCD_GetYSize(void);
 
 /* functions using the LTDC controller */
 void     BSP_LCD_LayerDefaultInit(uint16_t LayerIndex, uint32_t FrameBuffer);
+void     BSP_LCD_LayerInit(uint16_t LayerIndex, uint32_t FrameBuffer, uint32_t PixelFormat);
+void     BSP_LCD_SetPixelFormat(uint32_t LayerIndex, uint32_t PixelFormat);
 void     BSP_LCD_SetTransparency(uint32_t LayerIndex, uint8_t Transparency);
 void     BSP_LCD_SetTransparency_NoReload(uint32_t LayerIndex, uint8_t Transparency);
 void     BSP_LCD_SetLayerAddress(uint32_t LayerIndex, uint32_t Address);
@@ -201,6 +209,9 @@ void     BSP_LCD_SelectLayer(uint32_t LayerIndex);
 void     BSP_LCD_SetLayerVisible(uint32_t LayerIndex, FunctionalState state);
 void     BSP_LCD_SetLayerVisible_NoReload(uint32_t LayerIndex, FunctionalState State);
 void     BSP_LCD_Relaod(uint32_t ReloadType);
+void     BSP_LCD_EnableDoubleBuffer(uint32_t LayerIndex);
+void     BSP_LCD_SwapBuffers(uint32_t LayerIndex);
+void     BSP_LCD_WaitForFlip(void);
 
 void     BSP_LCD_SetTextColor(uint32_t Color);
 void     BSP_LCD_SetBackColor(uint32_t Color);
@@ -225,6 +236,8 @@ void     BSP_LCD_DrawCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
 void     BSP_LCD_DrawPolygon(pPoint Points, uint16_t PointCount);
 void     BSP_LCD_DrawEllipse(int Xpos, int Ypos, int XRadius, int YRadius);
 void     BSP_LCD_DrawBitmap(uint32_t X, uint32_t Y, uint8_t *pBmp);
+void     BSP_LCD_SaveLines(uint16_t Ypos, uint16_t Height, uint32_t Dst);
+void     BSP_LCD_RestoreLines(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height, uint32_t Src);
 
 void     BSP_LCD_FillRect(uint16_t Xpos, uint16_t Ypos, uint16_t Width, uint16_t Height);
 void     BSP_LCD_FillCircle(uint16_t Xpos, uint16_t Ypos, uint16_t Radius);
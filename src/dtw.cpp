@@ -0,0 +1,285 @@
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+#include "dtw.h"
+
+using std::array;
+
+// Rolling rows of the warping matrix, shared by all DTW calls (rotation thread only)
+static float dtwRowPrev[DTW_MAX_SEQ_LEN + 1];
+static float dtwRowCurr[DTW_MAX_SEQ_LEN + 1];
+
+// LB_Keogh envelope of the key, indexed by attempt sample
+static array<float, 3> dtwEnvUpper[DTW_MAX_SEQ_LEN];
+static array<float, 3> dtwEnvLower[DTW_MAX_SEQ_LEN];
+
+DTW_CascadeStats dtwStats = {0, 0, 0, 0, 0};
+
+// Smallest of the three predecessor cells in the warping matrix
+static inline float min3(float a, float b, float c)
+{
+    float m = (a < b) ? a : b;
+    return (m < c) ? m : c;
+}
+
+// Compute the Euclidean distance between two 3D points
+float calcEuclideanDist(const array<float, 3> &a, const array<float, 3> &b)
+{
+    float sum = 0;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+    return sqrt(sum);
+}
+
+// Compute the DTW (Dynamic Time Warping) distance between two sequences
+float calcDTW(const array<float, 3> *s, size_t s_len, const array<float, 3> *t, size_t t_len)
+{
+    return calcDTWBand(s, s_len, t, t_len, DTW_FULL_WINDOW);
+}
+
+// Banded rolling-row DTW; gives up (returns infinity) once a whole row exceeds threshold
+static float dtwBandKernel(const array<float, 3> *s, size_t s_len, const array<float, 3> *t, size_t t_len, size_t window, float threshold)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // DTW is symmetric, so let the shorter sequence index the row buffers
+    const array<float, 3> *rows = (s_len >= t_len) ? s : t;
+    const array<float, 3> *cols = (s_len >= t_len) ? t : s;
+    size_t n = (s_len >= t_len) ? s_len : t_len;
+    size_t m = (s_len >= t_len) ? t_len : s_len;
+
+    if (m > DTW_MAX_SEQ_LEN)
+    {
+        return inf;
+    }
+
+    float *prev = dtwRowPrev;
+    float *curr = dtwRowCurr;
+
+    prev[0] = 0;
+    for (size_t j = 1; j <= m; ++j)
+    {
+        prev[j] = inf;
+    }
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t lo, hi;
+        dtwBandRange(i, n, m, window, lo, hi);
+
+        float rowMin = inf;
+        curr[lo - 1] = inf;
+        for (size_t j = lo; j <= hi; ++j)
+        {
+            float cost = calcEuclideanDist(rows[i - 1], cols[j - 1]);
+            curr[j] = cost + min3(prev[j], curr[j - 1], prev[j - 1]);
+            if (curr[j] < rowMin)
+            {
+                rowMin = curr[j];
+            }
+        }
+        // Seal the band edge so the next row never reads a stale cell
+        if (hi < m)
+        {
+            curr[hi + 1] = inf;
+        }
+
+        // Every path crosses this row and costs only grow, so rowMin bounds the result
+        if (rowMin > threshold)
+        {
+            return inf;
+        }
+
+        float *swap = prev;
+        prev = curr;
+        curr = swap;
+    }
+
+    return prev[m];
+}
+
+// Compute the DTW distance restricted to a Sakoe-Chiba band around the diagonal
+float calcDTWBand(const array<float, 3> *s, size_t s_len, const array<float, 3> *t, size_t t_len, size_t window)
+{
+    return dtwBandKernel(s, s_len, t, t_len, window, std::numeric_limits<float>::infinity());
+}
+
+// Banded DTW that abandons as soon as the running row minimum exceeds threshold
+float calcDTWEarlyAbandon(const array<float, 3> *s, size_t s_len, const array<float, 3> *t, size_t t_len, size_t window, float threshold)
+{
+    return dtwBandKernel(s, s_len, t, t_len, window, threshold);
+}
+
+// Convert a band width given as a percentage of the longer sequence into samples
+size_t calcDTWWindow(size_t s_len, size_t t_len, float percent)
+{
+    size_t longest = (s_len > t_len) ? s_len : t_len;
+    if (percent >= 100.0f)
+    {
+        return DTW_FULL_WINDOW;
+    }
+    if (percent <= 0.0f)
+    {
+        return 0;
+    }
+    return (size_t)ceilf(longest * percent / 100.0f);
+}
+
+// Distance from a point to the axis-aligned box [lower, upper]
+static inline float distToBox(const array<float, 3> &p, const array<float, 3> &upper, const array<float, 3> &lower)
+{
+    float sum = 0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        float d = 0;
+        if (p[k] > upper[k])
+        {
+            d = p[k] - upper[k];
+        }
+        else if (p[k] < lower[k])
+        {
+            d = lower[k] - p[k];
+        }
+        sum += d * d;
+    }
+    return sqrt(sum);
+}
+
+// Per-axis minimum and maximum of a sequence
+static void seqExtrema(const array<float, 3> *seq, size_t len, array<float, 3> &lo, array<float, 3> &hi)
+{
+    lo = seq[0];
+    hi = seq[0];
+    for (size_t i = 1; i < len; ++i)
+    {
+        const array<float, 3> &p = seq[i];
+        for (size_t k = 0; k < 3; ++k)
+        {
+            lo[k] = (p[k] < lo[k]) ? p[k] : lo[k];
+            hi[k] = (p[k] > hi[k]) ? p[k] : hi[k];
+        }
+    }
+}
+
+// LB_Kim lower bound from the endpoints and per-axis extrema of both sequences
+float calcLBKim(const array<float, 3> *s, size_t s_len, const array<float, 3> *t, size_t t_len)
+{
+    if (s_len == 0 || t_len == 0)
+    {
+        return (s_len == 0 && t_len == 0) ? 0.0f : std::numeric_limits<float>::infinity();
+    }
+
+    // First and last cells lie on every warping path
+    float bound = calcEuclideanDist(s[0], t[0]);
+    if (s_len > 1 || t_len > 1)
+    {
+        bound += calcEuclideanDist(s[s_len - 1], t[t_len - 1]);
+    }
+
+    // A sample outside the other sequence's range on some axis costs at least the gap
+    array<float, 3> sLo, sHi, tLo, tHi;
+    seqExtrema(s, s_len, sLo, sHi);
+    seqExtrema(t, t_len, tLo, tHi);
+
+    float gap = 0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        gap = std::max({gap, sHi[k] - tHi[k], tHi[k] - sHi[k], tLo[k] - sLo[k], sLo[k] - tLo[k]});
+    }
+
+    return std::max(bound, gap);
+}
+
+// Build the LB_Keogh envelope of key for an attempt of attempt_len samples
+bool calcDTWEnvelope(const array<float, 3> *key, size_t key_len, size_t attempt_len, size_t window, array<float, 3> upper[], array<float, 3> lower[])
+{
+    if (key_len == 0 || attempt_len == 0 || attempt_len > DTW_MAX_SEQ_LEN)
+    {
+        return false;
+    }
+
+    const float inf = std::numeric_limits<float>::infinity();
+    for (size_t a = 0; a < attempt_len; ++a)
+    {
+        upper[a] = {-inf, -inf, -inf};
+        lower[a] = {inf, inf, inf};
+    }
+
+    // Walk the band with the longer sequence as rows, exactly as the DTW kernel does
+    bool keyIsRows = (key_len >= attempt_len);
+    size_t n = keyIsRows ? key_len : attempt_len;
+    size_t m = keyIsRows ? attempt_len : key_len;
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t lo, hi;
+        dtwBandRange(i, n, m, window, lo, hi);
+        for (size_t j = lo; j <= hi; ++j)
+        {
+            const array<float, 3> &p = keyIsRows ? key[i - 1] : key[j - 1];
+            size_t a = keyIsRows ? j - 1 : i - 1;
+            for (size_t k = 0; k < 3; ++k)
+            {
+                upper[a][k] = (p[k] > upper[a][k]) ? p[k] : upper[a][k];
+                lower[a][k] = (p[k] < lower[a][k]) ? p[k] : lower[a][k];
+            }
+        }
+    }
+
+    return true;
+}
+
+// LB_Keogh lower bound of an attempt against a precomputed key envelope
+float calcLBKeogh(const array<float, 3> *attempt, size_t attempt_len, const array<float, 3> upper[], const array<float, 3> lower[])
+{
+    float bound = 0;
+    for (size_t a = 0; a < attempt_len; ++a)
+    {
+        bound += distToBox(attempt[a], upper[a], lower[a]);
+    }
+    return bound;
+}
+
+// Score an attempt against the key through LB_Kim, LB_Keogh and early-abandoning DTW
+float scoreDTWCascade(const array<float, 3> *key, size_t key_len, const array<float, 3> *attempt, size_t attempt_len, size_t window, float threshold)
+{
+    // Attempts too long for the envelope buffers simply skip the LB_Keogh stage
+    bool haveEnvelope = calcDTWEnvelope(key, key_len, attempt_len, window, dtwEnvUpper, dtwEnvLower);
+
+    return scoreDTWCascadeEnvelope(key, key_len, attempt, attempt_len, haveEnvelope ? dtwEnvUpper : NULL,
+                                   haveEnvelope ? dtwEnvLower : NULL, window, threshold);
+}
+
+// Cascade scoring with a key envelope computed ahead of time
+float scoreDTWCascadeEnvelope(const array<float, 3> *key, size_t key_len, const array<float, 3> *attempt, size_t attempt_len,
+                              const array<float, 3> upper[], const array<float, 3> lower[], size_t window, float threshold)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+
+    dtwStats.attempts++;
+
+    if (calcLBKim(key, key_len, attempt, attempt_len) > threshold)
+    {
+        dtwStats.kim_pruned++;
+        return inf;
+    }
+
+    if (upper != NULL && lower != NULL && calcLBKeogh(attempt, attempt_len, upper, lower) > threshold)
+    {
+        dtwStats.keogh_pruned++;
+        return inf;
+    }
+
+    float dist = calcDTWEarlyAbandon(key, key_len, attempt, attempt_len, window, threshold);
+    if (dist > threshold)
+    {
+        dtwStats.dtw_abandoned++;
+        return inf;
+    }
+
+    dtwStats.dtw_completed++;
+    return dist;
+}
@@ -0,0 +1,82 @@
+#ifndef __DTW_H
+#define __DTW_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+
+// Float kernels over rates in dps. The unlock path scores the stored counts with their
+// integer counterparts in q15.h; these remain the reference the host tests check against.
+
+// Longest sequence the DTW row buffers can hold (applies to the shorter input)
+#define DTW_MAX_SEQ_LEN MAX_GESTURE_SAMPLES
+
+// Window value that disables the Sakoe-Chiba band (full warping matrix)
+#define DTW_FULL_WINDOW SIZE_MAX
+
+// Per-stage counters of the lower-bound cascade in scoreDTWCascade
+typedef struct
+{
+    uint32_t attempts;      // Attempts scored through the cascade
+    uint32_t kim_pruned;    // Rejected by LB_Kim
+    uint32_t keogh_pruned;  // Rejected by LB_Keogh
+    uint32_t dtw_abandoned; // Rejected by early-abandoning DTW
+    uint32_t dtw_completed; // DTW ran to completion within the threshold
+} DTW_CascadeStats;
+
+extern DTW_CascadeStats dtwStats;
+
+// Column range [lo, hi] (1-based) of row i inside the band, for n rows >= m columns.
+// The centre follows the scaled diagonal and advances by at most one column per
+// row, so any window keeps a valid warping path.
+static inline void dtwBandRange(size_t i, size_t n, size_t m, size_t window, size_t &lo, size_t &hi)
+{
+    size_t centre = (i * m + n - 1) / n;
+    lo = (centre > window) ? centre - window : 1;
+    hi = (m - centre > window) ? centre + window : m;
+}
+
+// Compute the Euclidean distance between two 3D points
+float calcEuclideanDist(const std::array<float, 3> &a, const std::array<float, 3> &b);
+
+// All sequence arguments below are contiguous samples with their length.
+
+// Compute the DTW (Dynamic Time Warping) distance between two sequences.
+// Only two preallocated rows of the warping matrix are kept, so no heap is used.
+// Returns infinity if the shorter sequence exceeds DTW_MAX_SEQ_LEN.
+float calcDTW(const std::array<float, 3> *s, size_t s_len, const std::array<float, 3> *t, size_t t_len);
+
+// Compute the DTW distance restricted to a Sakoe-Chiba band of +/- window samples
+// around the (length-scaled) diagonal. Cost is O(max(|s|,|t|) * window).
+float calcDTWBand(const std::array<float, 3> *s, size_t s_len, const std::array<float, 3> *t, size_t t_len, size_t window);
+
+// Banded DTW that returns infinity as soon as the running row minimum exceeds threshold
+float calcDTWEarlyAbandon(const std::array<float, 3> *s, size_t s_len, const std::array<float, 3> *t, size_t t_len, size_t window, float threshold);
+
+// Convert a band width given as a percentage of the longer sequence into samples
+size_t calcDTWWindow(size_t s_len, size_t t_len, float percent);
+
+// LB_Kim lower bound on DTW from the endpoints and per-axis extrema of both sequences
+float calcLBKim(const std::array<float, 3> *s, size_t s_len, const std::array<float, 3> *t, size_t t_len);
+
+// Build the LB_Keogh envelope (per-axis min/max of key inside the band) for each
+// of attempt_len attempt samples. Returns false if attempt_len exceeds DTW_MAX_SEQ_LEN.
+bool calcDTWEnvelope(const std::array<float, 3> *key, size_t key_len, size_t attempt_len, size_t window,
+                     std::array<float, 3> upper[], std::array<float, 3> lower[]);
+
+// LB_Keogh lower bound on banded DTW of an attempt against a key envelope
+float calcLBKeogh(const std::array<float, 3> *attempt, size_t attempt_len, const std::array<float, 3> upper[], const std::array<float, 3> lower[]);
+
+// Score an attempt against the key: LB_Kim, then LB_Keogh, then early-abandoning DTW.
+// Returns the banded DTW distance, or infinity as soon as a stage proves it exceeds threshold.
+float scoreDTWCascade(const std::array<float, 3> *key, size_t key_len, const std::array<float, 3> *attempt, size_t attempt_len,
+                      size_t window, float threshold);
+
+// Same cascade with a key envelope built ahead of time by calcDTWEnvelope for this
+// attempt length and window; pass NULL envelopes to skip the LB_Keogh stage.
+float scoreDTWCascadeEnvelope(const std::array<float, 3> *key, size_t key_len, const std::array<float, 3> *attempt, size_t attempt_len,
+                              const std::array<float, 3> upper[], const std::array<float, 3> lower[], size_t window, float threshold);
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef __GESTURE_BUFFER_H
+#define __GESTURE_BUFFER_H
+
+#include <array>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Statically allocated sample storage in calibrated gyro counts, one contiguous array per axis
+template <size_t N>
+struct GestureStorage
+{
+    int16_t axis[3][N];
+    uint32_t t_us[N]; // Sample times in microseconds
+};
+
+// Fixed-capacity gesture recording over caller-provided storage. Samples are stored
+// structure-of-arrays so each axis can be handed to a kernel as one contiguous run.
+// The buffer never allocates; moving or swapping exchanges the storage, not the data.
+template <size_t N>
+class GestureBuffer
+{
+public:
+    explicit GestureBuffer(GestureStorage<N> &storage) : store(&storage), len(0) {}
+
+    // A moved-from buffer is left empty with no storage
+    GestureBuffer(GestureBuffer &&other) : store(other.store), len(other.len)
+    {
+        other.store = NULL;
+        other.len = 0;
+    }
+    GestureBuffer &operator=(GestureBuffer &&other)
+    {
+        swap(other);
+        return *this;
+    }
+    GestureBuffer(const GestureBuffer &) = delete;
+    GestureBuffer &operator=(const GestureBuffer &) = delete;
+
+    void swap(GestureBuffer &other)
+    {
+        std::swap(store, other.store);
+        std::swap(len, other.len);
+    }
+
+    // Append one sample taken at t_us; returns false once the buffer is full
+    bool push(const std::array<int16_t, 3> &sample, uint32_t t_us = 0)
+    {
+        if (store == NULL || len >= N)
+        {
+            return false;
+        }
+        for (size_t k = 0; k < 3; ++k)
+        {
+            store->axis[k][len] = sample[k];
+        }
+        store->t_us[len] = t_us;
+        len++;
+        return true;
+    }
+
+    std::array<int16_t, 3> operator[](size_t i) const
+    {
+        return {store->axis[0][i], store->axis[1][i], store->axis[2][i]};
+    }
+
+    // Contiguous samples of one axis
+    const int16_t *axis(size_t k) const
+    {
+        return store->axis[k];
+    }
+
+    // Sample times, parallel to the axes
+    const uint32_t *timestamps() const
+    {
+        return store->t_us;
+    }
+
+    // Keep samples [start, end) only, moving them to the front
+    void keep(size_t start, size_t end)
+    {
+        end = (end < len) ? end : len;
+        start = (start < end) ? start : end;
+        if (start != 0)
+        {
+            for (size_t k = 0; k < 3; ++k)
+            {
+                memmove(store->axis[k], store->axis[k] + start, (end - start) * sizeof(int16_t));
+            }
+            memmove(store->t_us, store->t_us + start, (end - start) * sizeof(uint32_t));
+        }
+        len = end - start;
+    }
+
+    // Drop everything after the first n samples
+    void truncate(size_t n)
+    {
+        len = (n < len) ? n : len;
+    }
+
+    void clear()
+    {
+        len = 0;
+    }
+
+    size_t size() const
+    {
+        return len;
+    }
+    bool empty() const
+    {
+        return len == 0;
+    }
+    static constexpr size_t capacity()
+    {
+        return N;
+    }
+
+private:
+    GestureStorage<N> *store;
+    size_t len;
+};
+
+#endif
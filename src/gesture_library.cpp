@@ -0,0 +1,255 @@
+#include <string.h>
+#include <math.h>
+#include <utility>
+
+#include "gesture_library.h"
+#include "dtw.h"
+#include "q15.h"
+
+// Contiguous store of the resampled templates, one fixed-size slot each
+static ResampledGesture libSamples[GESTURE_LIBRARY_CAPACITY];
+static TemplateCache libCache[GESTURE_LIBRARY_CAPACITY];
+
+static GestureTemplate libTemplates[GESTURE_LIBRARY_CAPACITY];
+static size_t libCount = 0;
+static uint32_t libClock = 0; // Advanced on every enrollment and unlock
+
+// Template indices sorted by (dominant axis, length)
+static uint8_t libIndex[GESTURE_LIBRARY_CAPACITY];
+
+// Ordering used by the descriptor index
+static inline bool indexLess(const GestureDescriptor &a, uint8_t axis, uint16_t length)
+{
+    return (a.dominant_axis < axis) || (a.dominant_axis == axis && a.length < length);
+}
+
+// First index position whose descriptor is not below (axis, length)
+static size_t indexLowerBound(uint8_t axis, uint16_t length)
+{
+    size_t lo = 0;
+    size_t hi = libCount;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (indexLess(libTemplates[libIndex[mid]].desc, axis, length))
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Descriptor distance used to rank candidates before full scoring
+static float descriptorDistance(const GestureDescriptor &a, const GestureDescriptor &b)
+{
+    float dist = fabsf((float)a.length - b.length) / (a.length + b.length);
+    for (size_t k = 0; k < 3; ++k)
+    {
+        float sum = a.energy[k] + b.energy[k];
+        if (sum > 0)
+        {
+            dist += fabsf(a.energy[k] - b.energy[k]) / sum;
+        }
+    }
+    return dist;
+}
+
+// Compute the index descriptors of a resampled recording
+void computeGestureDescriptor(const ResampledGesture &samples, size_t duration, GestureDescriptor &desc)
+{
+    desc.length = (uint16_t)duration;
+    desc.dominant_axis = 0;
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        float sum = 0;
+        for (size_t i = 0; i < GESTURE_RESAMPLE_LEN; ++i)
+        {
+            sum += (float)samples.axis[k][i] * samples.axis[k][i];
+        }
+        desc.energy[k] = sum / GESTURE_RESAMPLE_LEN;
+
+        if (desc.energy[k] > desc.energy[desc.dominant_axis])
+        {
+            desc.dominant_axis = (uint8_t)k;
+        }
+    }
+}
+
+// Enroll a resampled recording
+int addGestureTemplate(const ResampledGesture &samples, size_t duration)
+{
+    if (duration == 0)
+    {
+        return -1;
+    }
+
+    size_t slot = libCount;
+    if (libCount >= GESTURE_LIBRARY_CAPACITY)
+    {
+        // Full: the template used least recently makes room, leaving the index
+        slot = 0;
+        for (size_t i = 1; i < libCount; ++i)
+        {
+            if (libTemplates[i].last_used < libTemplates[slot].last_used)
+            {
+                slot = i;
+            }
+        }
+
+        size_t pos = 0;
+        while (libIndex[pos] != slot)
+        {
+            pos++;
+        }
+        libCount--;
+        memmove(&libIndex[pos], &libIndex[pos + 1], (libCount - pos) * sizeof(libIndex[0]));
+    }
+
+    GestureTemplate &tmpl = libTemplates[slot];
+    tmpl.last_used = ++libClock;
+    computeGestureDescriptor(samples, duration, tmpl.desc);
+    libSamples[slot] = samples;
+    buildTemplateCache(samples, calcDTWWindow(GESTURE_RESAMPLE_LEN, GESTURE_RESAMPLE_LEN, GESTURE_LIBRARY_WINDOW_PERCENT),
+                       libCache[slot]);
+
+    // Insert into the sorted index
+    size_t pos = indexLowerBound(tmpl.desc.dominant_axis, tmpl.desc.length);
+    memmove(&libIndex[pos + 1], &libIndex[pos], (libCount - pos) * sizeof(libIndex[0]));
+    libIndex[pos] = (uint8_t)slot;
+    libCount++;
+
+    return (int)slot;
+}
+
+// Record that a template has just unlocked the board
+void markGestureUsed(size_t index)
+{
+    libTemplates[index].last_used = ++libClock;
+}
+
+// Number of enrolled templates
+size_t getGestureCount()
+{
+    return libCount;
+}
+
+// Access an enrolled template
+const GestureTemplate &getGestureTemplate(size_t index)
+{
+    return libTemplates[index];
+}
+
+// Access the samples of an enrolled template
+const ResampledGesture &getGestureSamples(size_t index)
+{
+    return libSamples[index];
+}
+
+// Access the cache of an enrolled template
+const TemplateCache &getGestureCache(size_t index)
+{
+    return libCache[index];
+}
+
+// Find the enrolled template nearest to an attempt
+GestureMatch findNearestGesture(const ResampledGesture &attempt, size_t duration)
+{
+    GestureMatch match = {-1, INFINITY, 0, 0};
+    if (duration == 0)
+    {
+        return match;
+    }
+
+    GestureDescriptor query;
+    computeGestureDescriptor(attempt, duration, query);
+
+    uint16_t minLen = (uint16_t)(duration / GESTURE_LIBRARY_DURATION_RATIO);
+    float maxLen = duration * GESTURE_LIBRARY_DURATION_RATIO;
+
+    // Shortlist of the nearest candidates by descriptor, kept sorted
+    uint8_t shortlist[GESTURE_LIBRARY_SHORTLIST];
+    float shortDist[GESTURE_LIBRARY_SHORTLIST];
+    size_t shortCount = 0;
+
+    for (uint8_t axis = 0; axis < 3; ++axis)
+    {
+        if (query.energy[axis] < GESTURE_LIBRARY_AXIS_RATIO * query.energy[query.dominant_axis])
+        {
+            continue;
+        }
+
+        for (size_t pos = indexLowerBound(axis, minLen); pos < libCount; ++pos)
+        {
+            const GestureDescriptor &desc = libTemplates[libIndex[pos]].desc;
+            if (desc.dominant_axis != axis || desc.length > maxLen)
+            {
+                break;
+            }
+            match.candidates++;
+
+            float dist = descriptorDistance(query, desc);
+            size_t slot = shortCount;
+            while (slot > 0 && shortDist[slot - 1] > dist)
+            {
+                if (slot < GESTURE_LIBRARY_SHORTLIST)
+                {
+                    shortlist[slot] = shortlist[slot - 1];
+                    shortDist[slot] = shortDist[slot - 1];
+                }
+                slot--;
+            }
+            if (slot < GESTURE_LIBRARY_SHORTLIST)
+            {
+                shortlist[slot] = libIndex[pos];
+                shortDist[slot] = dist;
+                if (shortCount < GESTURE_LIBRARY_SHORTLIST)
+                {
+                    shortCount++;
+                }
+            }
+        }
+    }
+
+    // Order the shortlist by a coarse DTW on the downsampled copies, so the likely
+    // match is scored first and its distance tightens every later cascade
+    CoarseGesture coarse;
+    downsampleGesture(attempt, coarse);
+
+    uint32_t coarseDist[GESTURE_LIBRARY_SHORTLIST];
+    for (size_t c = 0; c < shortCount; ++c)
+    {
+        coarseDist[c] = calcDTWQ15(viewGestureQ15(libCache[shortlist[c]].coarse), viewGestureQ15(coarse), DTW_FULL_WINDOW,
+                                   Q15_DTW_INFINITY);
+        for (size_t j = c; j > 0 && coarseDist[j - 1] > coarseDist[j]; --j)
+        {
+            std::swap(coarseDist[j - 1], coarseDist[j]);
+            std::swap(shortlist[j - 1], shortlist[j]);
+        }
+    }
+
+    // The first candidate is scored in full; the rest only while they can still beat it
+    uint32_t bestDist = Q15_DTW_INFINITY;
+    GestureQ15 attemptView = viewGestureQ15(attempt);
+
+    for (size_t c = 0; c < shortCount; ++c)
+    {
+        const TemplateCache &cache = libCache[shortlist[c]];
+        uint32_t dist = scoreDTWCascadeQ15(viewGestureQ15(libSamples[shortlist[c]]), attemptView, &cache.upper, &cache.lower,
+                                           cache.window, bestDist);
+        match.scored++;
+
+        if (dist != Q15_DTW_INFINITY && dist < bestDist)
+        {
+            match.index = shortlist[c];
+            bestDist = dist;
+            match.mean_cost = (float)dist * Q15_DPS_PER_COUNT / GESTURE_RESAMPLE_LEN;
+        }
+    }
+
+    return match;
+}
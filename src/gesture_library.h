@@ -0,0 +1,73 @@
+#ifndef __GESTURE_LIBRARY_H
+#define __GESTURE_LIBRARY_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "resample.h"
+#include "template_cache.h"
+
+// Number of templates the library can hold
+#define GESTURE_LIBRARY_CAPACITY 8
+// Templates fully scored per lookup, nearest descriptors first
+#define GESTURE_LIBRARY_SHORTLIST 3
+// Largest duration ratio between an attempt and a candidate template
+#define GESTURE_LIBRARY_DURATION_RATIO 1.5f
+// DTW band half-width as a percentage of the resampled length
+#define GESTURE_LIBRARY_WINDOW_PERCENT 20.0f
+// Axes with at least this fraction of the attempt's dominant energy are also searched
+#define GESTURE_LIBRARY_AXIS_RATIO 0.5f
+
+// Cheap descriptors the library is indexed on
+typedef struct
+{
+    uint16_t length;       // Duration in samples before resampling
+    float energy[3];       // Mean squared rate per axis
+    uint8_t dominant_axis; // Axis with the largest energy
+} GestureDescriptor;
+
+// One enrolled template; its resampled samples share the index in the store
+typedef struct
+{
+    GestureDescriptor desc; // Index key
+    uint32_t last_used;     // Library clock when enrolled or last unlocked with
+} GestureTemplate;
+
+// Result of a 1:N lookup
+typedef struct
+{
+    int index;          // Nearest template, or -1 if no template is a plausible candidate
+    float mean_cost;    // Banded DTW distance of the match per resampled sample (dps)
+    uint8_t candidates; // Templates that passed the descriptor index
+    uint8_t scored;     // Templates scored with the DTW cascade
+} GestureMatch;
+
+// Compute the index descriptors of a resampled recording of the given original duration
+void computeGestureDescriptor(const ResampledGesture &samples, size_t duration, GestureDescriptor &desc);
+
+// Enroll a resampled recording; returns its index, or -1 if the recording is empty.
+// Once the library is full the template used least recently is replaced.
+int addGestureTemplate(const ResampledGesture &samples, size_t duration);
+
+// Record that a template has just unlocked the board, so it is replaced last
+void markGestureUsed(size_t index);
+
+// Number of enrolled templates
+size_t getGestureCount();
+
+// Access an enrolled template and its samples
+const GestureTemplate &getGestureTemplate(size_t index);
+const ResampledGesture &getGestureSamples(size_t index);
+
+// Statistics and derived copies of a template, computed when it was enrolled
+const TemplateCache &getGestureCache(size_t index);
+
+// Find the enrolled template nearest to a resampled attempt. Only candidates whose
+// original duration and dominant axis are plausible are scored, with banded DTW in
+// counts; each candidate is abandoned once it is proven farther than the best so far.
+// Whether the nearest template is close enough to unlock is left to the caller.
+GestureMatch findNearestGesture(const ResampledGesture &attempt, size_t duration);
+
+#endif
@@ -1,5 +1,4 @@
 #include <mbed.h>
-#include <vector>
 #include <array>
 #include <limits>
 #include <cmath>
@@ -7,6 +6,19 @@
 
 #include "motion.h"
 #include "constants.h"
+#include "dtw.h"
+#include "gesture_library.h"
+#include "q15.h"
+#include "streaming_dtw.h"
+#include "segmenter.h"
+#include "resample.h"
+#include "decimator.h"
+#include "bias_tracker.h"
+#include "calibration_store.h"
+#include "spsc_ring.h"
+#include "gesture_buffer.h"
+#include "timing_stats.h"
+#include "status_line.h"
 
 #include "drivers/LCD_DISCO_F429ZI.h"
 #include "drivers/TS_DISCO_F429ZI.h"
@@ -15,42 +27,124 @@
 #define KEY_FLAG 1
 #define UNLOCK_FLAG 2
 #define DATA_READY_FLAG 8
-// LCD font size for text display
-#define FONT_SIZE 16
+#define CAPTURE_FLAG 16     // A capture is running and the sensor FIFO may be read
+#define BLOCK_DONE_FLAG 32    // A block transfer has completed (acquisition thread)
+#define SAMPLES_READY_FLAG 64 // New samples are waiting in the sample ring
+#define MOTION_FLAG 256     // The armed gyro saw motion on INT1
+// FIFO watermark: one block every 10 samples (50 ms at the 200 Hz ODR)
+#define FIFO_WATERMARK 10
+// Raw samples buffered between acquisition and processing (1.28 s at 200 Hz)
+#define SAMPLE_RING_CAPACITY 256
+// Every ODR sample is filtered; gestures are kept at 200 Hz / 8 = 25 Hz
+#define DECIMATION_FILTER DECIMATE_FIR
+#define DECIMATION_FACTOR 8
+// Longest capture, and the samples it can hold at the decimated gesture rate
+#define CAPTURE_ODR_HZ 200
+#define CAPTURE_MAX_SECONDS 5
+#define CAPTURE_MAX_SAMPLES (CAPTURE_ODR_HZ / DECIMATION_FACTOR * CAPTURE_MAX_SECONDS)
+#define CAPTURE_PERIOD_US (1000000 / CAPTURE_ODR_HZ)
+// Bin widths of the sample period and block latency histograms
+#define PERIOD_HIST_BIN_US 100
+#define LATENCY_HIST_BIN_US 1000
 // Threshold for determining successful unlock
 #define CORRELATION_THRESHOLD 0.3f
+// Mean DTW cost per warping step (dps) at which a streamed attempt ends recording early
+#define STREAM_ACCEPT_MEAN_COST 40.0f
+// Rotation rate (dps) that marks gesture onset, and the lower rate that counts as still
+#define SEGMENT_ONSET_DPS 20.0f
+#define SEGMENT_RELEASE_DPS 10.0f
+// Still samples that end a gesture (about 0.5 s at 25 Hz) and shortest accepted gesture
+#define SEGMENT_QUIET_SAMPLES 12
+#define SEGMENT_MIN_MOTION_SAMPLES 5
+// Armed (idle) mode: rate that wakes the board, samples (~100 Hz) it must persist, and
+// how many capture-rate samples each ~100 Hz history sample stands for
+#define MOTION_WAKE_DPS 30.0f
+#define MOTION_WAKE_DURATION 2
+#define MOTION_WAKE_UPSAMPLE 2
+// Time a motion-triggered capture waits for the segmenter to see a gesture onset
+#define MOTION_WAKE_ONSET_TIMEOUT 500ms
+// Idle period between FIFO reads for bias tracking. Each read wakes the MCU for the
+// ~2 ms SPI drain of one stillness window (the ~0.33 s the FIFO holds), so at 10 s the
+// tracker sees ~3% of the idle samples for ~0.02% extra active time; shorter periods
+// track faster drift at a proportional power cost.
+#define BIAS_IDLE_PERIOD 10s
+// Per-axis noise variance (counts^2) below which the board counts as resting, and the
+// offset change (counts, ~0.35 dps at 500 dps) beyond which a press recalibrates first
+#define BIAS_STILL_VARIANCE 64.0f
+#define BIAS_DRIFT_BOUND 20.0f
+// Set to 1 to dump calibration, capture timing and scoring statistics to the serial
+// console. At the default 9600 baud this blocks each capture for hundreds of ms.
+#ifndef DEBUG_TIMING
+#define DEBUG_TIMING 0
+#endif
+#define TIMING_PRINTF(...) do { if (DEBUG_TIMING) printf(__VA_ARGS__); } while (0)
 
 InterruptIn rotIntPin(PA_2, PullDown);
+InterruptIn motionIntPin(PA_1, PullDown);
 DigitalOut greenLed(LED1);
 DigitalOut redLed(LED2);
 LCD_DISCO_F429ZI display;    // LCD control object
+StatusLine statusLine;       // Bottom text line, drawn from a pre-rendered cache
 TS_DISCO_F429ZI touchScreen; // Touch screen control object
 EventFlags evtFlags;         // Event flags to communicate between threads
+Mutex sensorMutex;           // Held by the acquisition thread while it owns the SPI bus
 Timer sysTimer;              // General-purpose timer
 
+// Estimates per-sample data-ready times from the watermark edges; only the sample that
+// raised an edge is timestamped, the rest of its block is interpolated
+typedef struct
+{
+    uint32_t drained;      // Samples read out of the FIFO this capture
+    uint32_t anchor_index; // Sample that raised the latest watermark edge
+    uint32_t anchor_us;    // Time of that edge
+    bool anchored;         // An edge has been seen this capture
+    float period_us;       // Sample period measured between the last two edges
+} AcquisitionClock;
+
 // Function Prototypes
 void renderButton(int x, int y, int width, int height, const char *label);
 bool checkButtonTouch(int touch_x, int touch_y, int button_x, int button_y, int button_width, int button_height);
-float calcEuclideanDist(const array<float, 3> &a, const array<float, 3> &b);
-float calcDTW(const vector<array<float, 3>> &s, const vector<array<float, 3>> &t);
-void removeZeroData(vector<array<float, 3>> &data);
-float calcCorrelation(const vector<float> &a, const vector<float> &b);
-array<float, 3> calcCorrelationVecs(vector<array<float, 3>> &vec1, vector<array<float, 3>> &vec2);
+void startStreamMatchers(size_t count);
+void resetAcquisitionClock();
+void queueTimedBlock(const RotationSensor_RawValues *block, size_t count, bool fromEdge, uint32_t edgeUs);
 void rotationThread();
+void acquisitionThread();
 void touchThread();
-bool flashStoreRotData(vector<array<float, 3>> &gestureKey, uint32_t flash_address);
-vector<array<float, 3>> flashReadRotData(uint32_t flash_address, size_t data_size);
-float movAvgFilter(float input, float dispBuf[], size_t N, size_t &index, float &sum);
+
+volatile uint32_t rotEdgeUs = 0;    // Time of the latest INT2 rising edge
+volatile uint32_t motionEdgeUs = 0; // Time of the latest INT1 (motion wake) rising edge
 
 // ISR for rotation sensor data-ready interrupt
 void onRotDataReady()
 {
+    rotEdgeUs = readTimestampUs();
     evtFlags.set(DATA_READY_FLAG);
 }
 
+// ISR for the rotation sensor threshold (motion wake) interrupt
+void onMotionWake()
+{
+    motionEdgeUs = readTimestampUs();
+    evtFlags.set(MOTION_FLAG);
+}
+
+// Called from the SPI transfer-complete interrupt once a FIFO block is in memory
+void onRotBlockRead()
+{
+    evtFlags.set(BLOCK_DONE_FLAG);
+}
+
 // Global Variables
-vector<array<float, 3>> gestureKey;   // Holds the recorded gesture key
-vector<array<float, 3>> unlockRecord; // Holds the recorded attempt for unlocking
+ResampledGesture gestureRecord;        // Latest recording, resampled for scoring
+GestureStorage<CAPTURE_MAX_SAMPLES> captureStorage;    // Backing store of the capture buffer
+StreamingDTW streamMatchers[GESTURE_LIBRARY_CAPACITY]; // Online matchers, one per enrolled key
+GestureSegmenter segmenter;                             // Detects gesture onset and end
+Decimator decimator;                                    // Anti-aliasing filter from ODR to gesture rate
+BiasTracker biasTracker;                                // Zero-rate level refined while idle
+SpscRing<TimedSample, SAMPLE_RING_CAPACITY> sampleRing; // Acquisition -> rotation thread
+AcquisitionClock acqClock;                              // Sample timing state (acquisition thread)
+IntervalHistogram periodHist;                           // Measured sample period per watermark
+IntervalHistogram latencyHist;                          // Watermark edge to samples queued
 
 const int btn1X = 60;
 const int btn1Y = 80;
@@ -70,13 +164,15 @@ const char *welcomeMsg = "Armadillo Secure";
 
 const int txtX = 5;
 const int txtY = 270;
-const char *txt0 = "NO KEY RECORDED";
-const char *txt1 = "LOCKED";
 
 int calcError = 0;
 
 int main()
 {
+    // 16-bit pixels halve the SDRAM traffic of every fill and of the LCD refresh
+    display.SetPixelFormat(LCD_BACKGROUND_LAYER, LCD_PIXEL_FORMAT_RGB565);
+    // Draw off screen and flip during vertical blanking so updates never tear
+    display.EnableDoubleBuffer(LCD_BACKGROUND_LAYER);
     display.Clear(LCD_COLOR_BLACK);
 
     // Draw the "RECORD" button
@@ -93,21 +189,29 @@ int main()
 
     // Setup interrupts
     rotIntPin.rise(&onRotDataReady);
+    motionIntPin.rise(&onMotionWake);
+
+    // Render every status message once; updates then only copy the changed span
+    initStatusLine(statusLine, display, LCD_BACKGROUND_LAYER, txtX, txtY);
 
     // Setup initial LED and text state
-    if (gestureKey.empty())
+    if (getGestureCount() == 0)
     {
         redLed = 0;
         greenLed = 1;
-        display.DisplayStringAt(txtX, txtY, (uint8_t *)txt0, CENTER_MODE);
+        showStatus(statusLine, STATUS_NO_KEY);
     }
     else
     {
         redLed = 1;
         greenLed = 0;
-        display.DisplayStringAt(txtX, txtY, (uint8_t *)txt1, CENTER_MODE);
+        showStatus(statusLine, STATUS_LOCKED);
     }
 
+    // Create thread moving FIFO blocks off the sensor; it must preempt the matcher
+    Thread acqThread(osPriorityHigh);
+    acqThread.start(callback(acquisitionThread));
+
     // Create thread for rotation sensor operations
     Thread rotationKeyThread;
     rotationKeyThread.start(callback(rotationThread));
@@ -130,13 +234,33 @@ void rotationThread()
     RotationSensor_Init_Params initParams;
     initParams.sampling_rate_conf = ODR_200HZ_CUTOFF_50HZ;
     initParams.irq_conf = INT2_DATA_READY;
+    // Gestures are stored in counts of this range; Q15_DPS_PER_COUNT must match it
     initParams.scale_conf = FULL_SCALE_500_DPS;
 
     // Holds the raw rotation sensor data
     RotationSensor_RawValues rawVals;
 
-    // Buffer used to show status messages on the LCD
-    char dispBuf[50];
+    // Samples drained from the idle FIFO, the sample being processed and one filtered output
+    RotationSensor_RawValues fifoBurst[FIFO_DEPTH];
+    TimedSample timed;
+    RotationSensor_RawValues filtered;
+
+    // Pre-trigger history from the armed FIFO, repeated up to the capture rate
+    RotationSensor_RawValues history[MOTION_WAKE_UPSAMPLE * FIFO_DEPTH];
+    bool armed = false;
+
+    // Samples of the gesture being captured, at the gesture rate
+    GestureBuffer<CAPTURE_MAX_SAMPLES> tempKey(captureStorage);
+
+    // Configure the sensor once; its calibration persists across presses and resets
+    RotationSensor_Calibration calibration;
+    ConfigureRotationSensor(&initParams);
+    bool needCalibration = !loadRotationCalibration(initParams.scale_conf, calibration);
+    if (!needCalibration)
+    {
+        SetRotationCalibration(&calibration);
+        initBiasTracker(biasTracker, calibration, BIAS_STILL_VARIANCE, BIAS_DRIFT_BOUND);
+    }
 
     // Handle the possible scenario where rotation data-ready line might be high at start-up
     if (!(evtFlags.get() & DATA_READY_FLAG) && (rotIntPin.read() == 1))
@@ -146,128 +270,306 @@ void rotationThread()
 
     while (1)
     {
-        vector<array<float, 3>> tempKey; // Temporary storage of recorded data
+        size_t recordLen = 0; // Duration of the recording in samples
+        tempKey.clear();
+
+        // Sleep armed until a press or motion; the FIFO keeps the latest samples and
+        // freezes them at the motion event
+        if (!armed)
+        {
+            ArmRotationMotionWake(MOTION_WAKE_DPS, MOTION_WAKE_DURATION);
+            evtFlags.clear(MOTION_FLAG);
+            // INT1 is latched, so an event raised while arming would never give an edge
+            if (motionIntPin.read() == 1)
+            {
+                motionEdgeUs = readTimestampUs();
+                evtFlags.set(MOTION_FLAG);
+            }
+            armed = true;
+        }
 
-        auto eventReceived = evtFlags.wait_any(KEY_FLAG | UNLOCK_FLAG);
+        uint32_t eventReceived = evtFlags.wait_any_for(KEY_FLAG | UNLOCK_FLAG | MOTION_FLAG, BIAS_IDLE_PERIOD);
 
-        if (eventReceived & (KEY_FLAG | UNLOCK_FLAG))
+        if (eventReceived & osFlagsError)
         {
-            // Prompt user to hold on
-            sprintf(dispBuf, "Please wait...");
-            display.SetTextColor(LCD_COLOR_BLACK);
-            display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-            display.SetTextColor(LCD_COLOR_BLUE);
-            display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
-
-            ThisThread::sleep_for(1s);
-
-            // Inform user about calibration
-            sprintf(dispBuf, "Configuring...");
-            display.SetTextColor(LCD_COLOR_BLACK);
-            display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-            display.SetTextColor(LCD_COLOR_BLUE);
-            display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
-
-            // Initialize sensor for rotation measurement
-            InitializeRotationSensor(&initParams, &rawVals);
-
-            sprintf(dispBuf, "Recording...");
-            display.SetTextColor(LCD_COLOR_BLACK);
-            display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-            display.SetTextColor(LCD_COLOR_BLUE);
-            display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
-
-            // Start collecting rotation data for a fixed duration
+            // Idle: refine the zero-rate level from the FIFO whenever the board is resting
+            size_t idleLen = ReadRotationMotionHistory(fifoBurst, FIFO_DEPTH);
+            bool refined = false;
+            for (size_t i = 0; i < idleLen && !needCalibration; i++)
+            {
+                BiasUpdate bias = updateBiasTracker(biasTracker, fifoBurst[i]);
+                if (bias == BIAS_REFINED)
+                {
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        calibration.offset[k] = (int16_t)lrintf(biasTracker.offset[k]);
+                    }
+                    SetRotationCalibration(&calibration);
+                    refined = true;
+                }
+                else if (bias == BIAS_DRIFTED)
+                {
+                    needCalibration = true;
+                }
+            }
+            // Keep the stored offsets current; rate-limited, as each save blocks for an erase
+            if (refined && !needCalibration)
+            {
+                refreshRotationCalibration(initParams.scale_conf, calibration);
+            }
+            continue;
+        }
+
+        // Leave armed mode; only a motion wake keeps the pre-trigger history. The FIFO
+        // stopped at the INT1 event, so its newest sample dates from the edge rather than
+        // from this read (the FIFO fills on past the edge only if a bias read just
+        // emptied it).
+        size_t historyLen = DisarmRotationMotionWake(&initParams, history, FIFO_DEPTH);
+        uint32_t historyEndUs = motionEdgeUs;
+        armed = false;
+
+        bool autoCapture = !(eventReceived & (KEY_FLAG | UNLOCK_FLAG));
+        if (autoCapture && (getGestureCount() == 0 || needCalibration))
+        {
+            // Nothing to unlock, or the board must rest for a calibration first
+            continue;
+        }
+        if (!autoCapture)
+        {
+            historyLen = 0;
+        }
+
+        // Repeat each ~100 Hz history sample to match the capture ODR
+        for (size_t i = historyLen; i-- > 0;)
+        {
+            for (size_t r = 0; r < MOTION_WAKE_UPSAMPLE; ++r)
+            {
+                history[i * MOTION_WAKE_UPSAMPLE + r] = history[i];
+            }
+        }
+        historyLen *= MOTION_WAKE_UPSAMPLE;
+
+        if (eventReceived & (KEY_FLAG | UNLOCK_FLAG | MOTION_FLAG))
+        {
+            // Only a missing or drifted calibration delays the recording
+            if (needCalibration)
+            {
+                showStatus(statusLine, STATUS_CONFIGURING);
+
+                uint32_t calSamples = CalibrateRotationSensor(&rawVals);
+                GetRotationCalibration(&calibration);
+                const RotationSensor_ReadStats *reads = GetRotationReadStats();
+                TIMING_PRINTF("Calibrated from %lu samples: offsets %d %d %d, thresholds %d %d %d\n", (unsigned long)calSamples,
+                              calibration.offset[0], calibration.offset[1], calibration.offset[2],
+                              calibration.threshold[0], calibration.threshold[1], calibration.threshold[2]);
+                TIMING_PRINTF("Calibration reads: %lu issued, %lu fresh, %lu duplicate, %lu overrun\n", (unsigned long)reads->reads,
+                              (unsigned long)reads->fresh, (unsigned long)reads->duplicates, (unsigned long)reads->overruns);
+                if (!storeRotationCalibration(initParams.scale_conf, calibration))
+                {
+                    printf("Calibration not saved to flash.\n");
+                }
+                initBiasTracker(biasTracker, calibration, BIAS_STILL_VARIANCE, BIAS_DRIFT_BOUND);
+                needCalibration = false;
+            }
+
+            // An automatic capture stays silent until it turns out to hold a gesture
+            if (!autoCapture)
+            {
+                showStatus(statusLine, STATUS_RECORDING);
+            }
+
+            // While unlocking, match every enrolled key as samples arrive
+            size_t streamCount = ((eventReceived & (UNLOCK_FLAG | MOTION_FLAG)) && !(eventReceived & KEY_FLAG)) ? getGestureCount() : 0;
+            startStreamMatchers(streamCount);
+            int streamMatch = -1;
+
+            initSegmenter(segmenter, SEGMENT_ONSET_DPS, SEGMENT_RELEASE_DPS, SEGMENT_QUIET_SAMPLES, SEGMENT_MIN_MOTION_SAMPLES);
+            initDecimator(decimator, DECIMATION_FILTER, DECIMATION_FACTOR);
+            bool captureDone = false;
+
+            // Let the sensor buffer samples at its full ODR; the acquisition thread moves
+            // each watermark's worth in by DMA and queues the samples in the ring
+            sampleRing.reset();
+            resetAcquisitionClock();
+            EnableRotationBlockReads(FIFO_WATERMARK, &onRotBlockRead);
+            evtFlags.clear(SAMPLES_READY_FLAG);
+            evtFlags.set(CAPTURE_FLAG);
+
+            // Collect rotation data until the gesture ends, for at most a fixed duration
+            size_t historyPos = 0;
+            uint32_t liveSamples = 0;
             sysTimer.start();
-            while (sysTimer.elapsed_time() < 5s)
+            while (!captureDone && sysTimer.elapsed_time() < std::chrono::seconds(CAPTURE_MAX_SECONDS))
             {
-                // Wait for sensor data-ready signal
-                evtFlags.wait_all(DATA_READY_FLAG);
+                // The pre-trigger history is filtered ahead of the live samples
+                if (historyPos < historyLen)
+                {
+                    // History times are only nominal: counted back from the INT1 edge
+                    timed.raw = history[historyPos];
+                    timed.t_us = historyEndUs - (uint32_t)(historyLen - historyPos) * CAPTURE_PERIOD_US;
+                    historyPos++;
+                }
+                else if (sampleRing.pop(timed))
+                {
+                    liveSamples++;
+                }
+                else
+                {
+                    evtFlags.wait_any_for(SAMPLES_READY_FLAG, 100ms);
+                    continue;
+                }
+
+                // Filter every ODR sample; only decimated outputs reach the matchers
+                ApplyRotationCalibration(&timed.raw);
+                if (!pushDecimator(decimator, timed.raw, filtered))
+                {
+                    continue;
+                }
 
-                // Read and convert sensor data
-                FetchCalibratedRotationData();
+                // Gestures are kept and scored in counts; only the segmenter works in dps
+                array<int16_t, 3> sample = {filtered.x_axis_value, filtered.y_axis_value, filtered.z_axis_value};
+                array<float, 3> rate = {RawToDPS(sample[0]), RawToDPS(sample[1]), RawToDPS(sample[2])};
 
-                // Store converted values
-                tempKey.push_back({RawToDPS(rawVals.x_axis_value),
-                                   RawToDPS(rawVals.y_axis_value),
-                                   RawToDPS(rawVals.z_axis_value)});
+                SegmentState segState = updateSegmenter(segmenter, rate);
+                if (segState == SEGMENT_DONE)
+                {
+                    break;
+                }
+                else if (segState == SEGMENT_MOTION)
+                {
+                    // Store the sample; a full buffer ends the capture
+                    if (!tempKey.push(sample, timed.t_us))
+                    {
+                        break;
+                    }
+
+                    // Stop as soon as a key is confidently matched
+                    for (size_t k = 0; k < streamCount && streamMatch < 0; ++k)
+                    {
+                        if (updateStreamingDTW(streamMatchers[k], sample))
+                        {
+                            streamMatch = k;
+                        }
+                    }
+                    if (streamMatch >= 0)
+                    {
+                        break;
+                    }
+                }
+                else if (!tempKey.empty())
+                {
+                    // The burst was a blip; wait for a real onset
+                    tempKey.clear();
+                    startStreamMatchers(streamCount);
+                    // A motion wake that was only a blip gives up straight away
+                    captureDone = autoCapture;
+                }
 
-                ThisThread::sleep_for(50ms); // about 20Hz sampling
+                // An automatic capture also ends without an onset, or when a button is pressed
+                if (autoCapture && ((segmenter.state == SEGMENT_IDLE && sysTimer.elapsed_time() > MOTION_WAKE_ONSET_TIMEOUT) ||
+                                    (evtFlags.get() & (KEY_FLAG | UNLOCK_FLAG))))
+                {
+                    captureDone = true;
+                }
             }
             sysTimer.stop();
+            uint32_t captureMs = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(sysTimer.elapsed_time()).count();
             sysTimer.reset();
 
-            // Remove leading and trailing zeros from data
-            removeZeroData(tempKey);
+            // Wait out any block transfer still in flight before reconfiguring the sensor
+            evtFlags.clear(CAPTURE_FLAG);
+            sensorMutex.lock();
+            DisableRotationBlockReads(initParams.irq_conf);
+            sensorMutex.unlock();
+            if (GetRotationFIFOOverruns() != 0)
+            {
+                TIMING_PRINTF("FIFO overruns during capture: %lu\n", (unsigned long)GetRotationFIFOOverruns());
+            }
+            TIMING_PRINTF("Sample ring: high water %u of %u, %lu dropped\n", (unsigned)sampleRing.highWaterMark(),
+                          (unsigned)sampleRing.capacity(), (unsigned long)sampleRing.overrunCount());
+            // Samples still in the sensor FIFO when the capture stopped also count as missed here
+            uint32_t expectedSamples = captureMs * CAPTURE_ODR_HZ / 1000;
+            TIMING_PRINTF("Capture: %lu samples in %lu ms, %lu expected (%lu missed)\n", (unsigned long)liveSamples, (unsigned long)captureMs,
+                          (unsigned long)expectedSamples, (unsigned long)(expectedSamples > liveSamples ? expectedSamples - liveSamples : 0));
+            TIMING_PRINTF("Sample period: min %lu, max %lu, p99 %lu us over %lu watermarks\n", (unsigned long)periodHist.min_us,
+                          (unsigned long)periodHist.max_us, (unsigned long)intervalPercentile(periodHist, 0.99f), (unsigned long)periodHist.count);
+            TIMING_PRINTF("Block latency: min %lu, max %lu, p99 %lu us\n", (unsigned long)latencyHist.min_us,
+                          (unsigned long)latencyHist.max_us, (unsigned long)intervalPercentile(latencyHist, 0.99f));
+            if (decimator.stats.inputs != 0)
+            {
+                TIMING_PRINTF("Decimator: %lu in, %lu out, %lu cycles/sample mean, %lu worst\n",
+                              (unsigned long)decimator.stats.inputs, (unsigned long)decimator.stats.outputs,
+                              (unsigned long)(decimator.stats.total_cycles / decimator.stats.inputs),
+                              (unsigned long)decimator.stats.max_cycles);
+            }
+
+            // Keep only the stretch of the stream that matched the key
+            if (streamMatch >= 0)
+            {
+                const StreamingDTW &matcher = streamMatchers[streamMatch];
+                TIMING_PRINTF("Streaming match: key %d after %u samples\n", streamMatch + 1, (unsigned)tempKey.size());
 
-            sprintf(dispBuf, "Recording complete");
-            display.SetTextColor(LCD_COLOR_BLACK);
-            display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-            display.SetTextColor(LCD_COLOR_BLUE);
-            display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
+                tempKey.keep(matcher.best_start, matcher.best_end + 1);
+            }
+            else if (tempKey.size() > segmenter.motion_len)
+            {
+                // Drop the still samples recorded after the last motion
+                tempKey.truncate(segmenter.motion_len);
+            }
+
+            // Normalise the recording to a fixed length for scoring
+            recordLen = tempKey.size();
+            resampleGestureTimed(tempKey.axis(0), tempKey.axis(1), tempKey.axis(2), tempKey.timestamps(), recordLen, gestureRecord);
+            tempKey.clear();
+
+            if (!autoCapture)
+            {
+                showStatus(statusLine, STATUS_RECORDING_COMPLETE);
+            }
         }
 
         // Determine if we were recording a new key or attempting unlock
         if (eventReceived & KEY_FLAG)
         {
-            if (gestureKey.empty()) // Allow recording only if no key exists
-            {
-                sprintf(dispBuf, "Saving key...");
-                display.SetTextColor(LCD_COLOR_BLACK);
-                display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                display.SetTextColor(LCD_COLOR_BLUE);
-                display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
-
-                // Save the key
-                gestureKey = tempKey;
+            showStatus(statusLine, STATUS_SAVING_KEY);
 
-                // Clear temporary key
-                tempKey.clear();
+            // Enroll the recording as another template; a full library replaces the key
+            // unused longest
+            int keyIndex = addGestureTemplate(gestureRecord, recordLen);
 
+            if (keyIndex >= 0)
+            {
                 // Toggle LEDs to indicate key presence
                 redLed = 1;
                 greenLed = 0;
 
-                sprintf(dispBuf, "Key saved...");
-                display.SetTextColor(LCD_COLOR_BLACK);
-                display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                display.SetTextColor(LCD_COLOR_BLUE);
-                display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
+                showStatus(statusLine, STATUS_KEY_SAVED, keyIndex);
 
                 // Clear the KEY_FLAG to prevent re-triggering
                 evtFlags.clear(KEY_FLAG);
             }
-            else // Key already exists
+            else // Recording unusable
             {
-                sprintf(dispBuf, "Key Already Exists!");
-                display.SetTextColor(LCD_COLOR_BLACK);
-                display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                display.SetTextColor(LCD_COLOR_BLUE);
-                display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE); // Ensure proper centering
-
-                // Clear temporary key to avoid any further processing
-                tempKey.clear();
+                showStatus(statusLine, STATUS_KEY_NOT_SAVED);
 
                 // Clear the KEY_FLAG to prevent re-triggering
                 evtFlags.clear(KEY_FLAG);
             }
         }
-        else if (eventReceived & UNLOCK_FLAG)
+        else if (eventReceived & (UNLOCK_FLAG | MOTION_FLAG))
         {
-            evtFlags.clear(UNLOCK_FLAG);
-
-            unlockRecord = tempKey;
-            tempKey.clear();
-
-            if (gestureKey.empty())
+            if (!autoCapture)
             {
-                sprintf(dispBuf, "No key to match.");
-                display.SetTextColor(LCD_COLOR_BLACK);
-                display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                display.SetTextColor(LCD_COLOR_BLUE);
-                display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
+                evtFlags.clear(UNLOCK_FLAG);
+            }
 
-                unlockRecord.clear();
+            if (autoCapture && recordLen == 0)
+            {
+                // The motion wake was not a gesture; go back to sleep without a verdict
+            }
+            else if (getGestureCount() == 0)
+            {
+                showStatus(statusLine, STATUS_NO_KEY_TO_MATCH);
 
                 // LEDs indicate locked state since no key is saved
                 greenLed = 1;
@@ -277,50 +579,68 @@ void rotationThread()
             {
                 int unlockCount = 0;
 
-                array<float, 3> correlationResult = calcCorrelationVecs(gestureKey, unlockRecord);
-                if (calcError != 0)
+                // Find the nearest plausible template; the correlation below decides the unlock
+                GestureMatch match = findNearestGesture(gestureRecord, recordLen);
+
+                TIMING_PRINTF("Library lookup: %u candidates, %u scored\n", match.candidates, match.scored);
+
+                TIMING_PRINTF("DTW cascade: attempts = %lu, LB_Kim = %lu, LB_Keogh = %lu, abandoned = %lu, completed = %lu\n",
+                              (unsigned long)dtwStats.attempts, (unsigned long)dtwStats.kim_pruned, (unsigned long)dtwStats.keogh_pruned,
+                              (unsigned long)dtwStats.dtw_abandoned, (unsigned long)dtwStats.dtw_completed);
+
+                if (match.index < 0)
                 {
-                    printf("Error in correlation calculation: vector size mismatch.\n");
+                    TIMING_PRINTF("No enrolled key is a plausible candidate.\n");
                 }
                 else
                 {
-                    printf("Correlations: x = %f, y = %f, z = %f\n", correlationResult[0], correlationResult[1], correlationResult[2]);
+                    TIMING_PRINTF("Nearest key: %d (mean DTW cost %f)\n", match.index + 1, match.mean_cost);
 
-                    for (size_t i = 0; i < correlationResult.size(); i++)
+                    // Template-side statistics were cached when the key was enrolled
+                    array<int16_t, 3> correlationResult;
+                    calcError = calcCorrelationCachedQ15(viewGestureQ15(getGestureSamples(match.index)), getGestureCache(match.index).stats,
+                                                         viewGestureQ15(gestureRecord), correlationResult) ? 0 : -1;
+                    if (calcError != 0)
                     {
-                        if (correlationResult[i] > CORRELATION_THRESHOLD)
+                        printf("Error in correlation calculation: flat or empty recording.\n");
+                    }
+                    else
+                    {
+                        TIMING_PRINTF("Correlations: x = %f, y = %f, z = %f\n", (float)correlationResult[0] / Q15_ONE,
+                                      (float)correlationResult[1] / Q15_ONE, (float)correlationResult[2] / Q15_ONE);
+
+                        for (size_t i = 0; i < correlationResult.size(); i++)
                         {
-                            unlockCount++;
+                            if (correlationResult[i] > CORRELATION_THRESHOLD * Q15_ONE)
+                            {
+                                unlockCount++;
+                            }
+                        }
+
+                        // A key that keeps unlocking the board is the last to be replaced
+                        if (unlockCount == 3)
+                        {
+                            markGestureUsed(match.index);
                         }
                     }
                 }
 
                 if (unlockCount == 3)
                 {
-                    sprintf(dispBuf, "UNLOCK SUCCESS");
-                    display.SetTextColor(LCD_COLOR_BLACK);
-                    display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                    display.SetTextColor(LCD_COLOR_BLUE);
-                    display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
+                    showStatus(statusLine, STATUS_UNLOCK_SUCCESS);
 
                     greenLed = 1;
                     redLed = 0;
 
-                    unlockRecord.clear();
                     unlockCount = 0;
                 }
                 else
                 {
-                    sprintf(dispBuf, "UNLOCK FAILED");
-                    display.SetTextColor(LCD_COLOR_BLACK);
-                    display.FillRect(0, txtY, display.GetXSize(), FONT_SIZE);
-                    display.SetTextColor(LCD_COLOR_BLUE);
-                    display.DisplayStringAt(txtX, txtY, (uint8_t *)dispBuf, CENTER_MODE);
+                    showStatus(statusLine, STATUS_UNLOCK_FAILED);
 
                     greenLed = 0;
                     redLed = 1;
 
-                    unlockRecord.clear();
                     unlockCount = 0;
                 }
             }
@@ -329,6 +649,44 @@ void rotationThread()
     }
 }
 
+// Thread moving sensor FIFO blocks into the sample ring while a capture runs
+void acquisitionThread()
+{
+    // Block copied out of the ping-pong buffer before its samples are queued
+    static RotationSensor_RawValues block[FIFO_DEPTH];
+
+    while (1)
+    {
+        // Sleep until a capture is running and the FIFO has reached its watermark
+        evtFlags.wait_all(CAPTURE_FLAG | DATA_READY_FLAG, osWaitForever, false);
+        evtFlags.clear(DATA_READY_FLAG);
+        uint32_t edgeUs = rotEdgeUs;
+        bool fromEdge = true;
+
+        sensorMutex.lock();
+
+        // INT2 stays high while the FIFO is at or above the watermark, and only its
+        // rising edge raises DATA_READY_FLAG, so keep reading until the line drops
+        while ((evtFlags.get() & CAPTURE_FLAG) && rotIntPin.read() == 1)
+        {
+            if (StartRotationBlockRead() != ROTATION_BLOCK_STARTED)
+            {
+                break;
+            }
+            evtFlags.wait_all(BLOCK_DONE_FLAG);
+
+            // Queue the samples straight away so the ping-pong half is free for the next
+            // transfer; a slow consumer shows up as ring overruns, never as a stalled bus
+            size_t count = ReadRotationBlock(block, FIFO_DEPTH);
+            queueTimedBlock(block, count, fromEdge, edgeUs);
+            fromEdge = false;
+            evtFlags.set(SAMPLES_READY_FLAG);
+        }
+
+        sensorMutex.unlock();
+    }
+}
+
 // Thread handling touch screen interactions
 void touchThread()
 {
@@ -366,38 +724,6 @@ void touchThread()
     }
 }
 
-// Store rotation-based gesture data to flash memory
-bool flashStoreRotData(vector<array<float, 3>> &gestureKey, uint32_t flash_address)
-{
-    FlashIAP flash;
-    flash.init();
-
-    uint32_t data_size = gestureKey.size() * sizeof(array<float, 3>);
-
-    flash.erase(flash_address, data_size);
-
-    int write_result = flash.program(gestureKey.data(), flash_address, data_size);
-
-    flash.deinit();
-
-    return (write_result == 0);
-}
-
-// Read stored rotation-based gesture data from flash
-vector<array<float, 3>> flashReadRotData(uint32_t flash_address, size_t data_size)
-{
-    vector<array<float, 3>> gestureKey(data_size);
-
-    FlashIAP flash;
-    flash.init();
-
-    flash.read(gestureKey.data(), flash_address, data_size * sizeof(array<float, 3>));
-
-    flash.deinit();
-
-    return gestureKey;
-}
-
 // Draw a rectangular button on the display
 void renderButton(int x, int y, int width, int height, const char *label)
 {
@@ -413,128 +739,70 @@ bool checkButtonTouch(int touch_x, int touch_y, int button_x, int button_y, int
             touch_y >= button_y && touch_y <= button_y + button_height);
 }
 
-// Compute the Euclidean distance between two 3D points
-float calcEuclideanDist(const array<float, 3> &a, const array<float, 3> &b)
-{
-    float sum = 0;
-    for (size_t i = 0; i < 3; ++i)
-    {
-        sum += (a[i] - b[i]) * (a[i] - b[i]);
-    }
-    return sqrt(sum);
-}
-
-// Compute the DTW (Dynamic Time Warping) distance between two sequences
-float calcDTW(const vector<array<float, 3>> &s, const vector<array<float, 3>> &t)
+// (Re)start the online matchers for the first count enrolled keys
+void startStreamMatchers(size_t count)
 {
-    vector<vector<float>> dtw_matrix(s.size() + 1, vector<float>(t.size() + 1, numeric_limits<float>::infinity()));
-
-    dtw_matrix[0][0] = 0;
-
-    for (size_t i = 1; i <= s.size(); ++i)
-    {
-        for (size_t j = 1; j <= t.size(); ++j)
-        {
-            float cost = calcEuclideanDist(s[i - 1], t[j - 1]);
-            dtw_matrix[i][j] = cost + min({dtw_matrix[i - 1][j], dtw_matrix[i][j - 1], dtw_matrix[i - 1][j - 1]});
-        }
-    }
-
-    return dtw_matrix[s.size()][t.size()];
-}
-
-// Remove leading/trailing segments of negligible rotation data
-void removeZeroData(vector<array<float, 3>> &data)
-{
-    float threshold = 0.00001;
-    auto startPtr = data.begin();
-    while (startPtr != data.end() && fabs((*startPtr)[0]) <= threshold && fabs((*startPtr)[1]) <= threshold && fabs((*startPtr)[2]) <= threshold)
-    {
-        startPtr++;
-    }
-    if (startPtr == data.end())
-        return;
-    auto leftPtr = startPtr;
-    startPtr = data.end() - 1;
-    while (startPtr != data.begin() && fabs((*startPtr)[0]) <= threshold && fabs((*startPtr)[1]) <= threshold && fabs((*startPtr)[2]) <= threshold)
-    {
-        startPtr--;
-    }
-    auto rightPtr = startPtr;
-
-    auto replacePtr = data.begin();
-    for (; replacePtr != leftPtr && leftPtr <= rightPtr; replacePtr++, leftPtr++)
-    {
-        *replacePtr = *leftPtr;
-    }
-    if (leftPtr > rightPtr)
-    {
-        data.erase(replacePtr, data.end());
-    }
-    else
+    for (size_t k = 0; k < count; ++k)
     {
-        data.erase(rightPtr + 1, data.end());
+        // The resampled template is matched against the raw stream, where the key
+        // spans its original length; the warping path is at least the longer of the
+        // two, so the accumulated cost is budgeted over that many steps
+        size_t keyLen = getGestureTemplate(k).desc.length;
+        size_t pathLen = (keyLen > GESTURE_RESAMPLE_LEN) ? keyLen : GESTURE_RESAMPLE_LEN;
+        uint32_t threshold = (uint32_t)(STREAM_ACCEPT_MEAN_COST / Q15_DPS_PER_COUNT * pathLen);
+        initStreamingDTW(streamMatchers[k], viewGestureQ15(getGestureSamples(k)), threshold);
     }
 }
 
-// Compute correlation between two equal-length numerical sequences
-float calcCorrelation(const vector<float> &a, const vector<float> &b)
+// Start sample timing afresh for a capture (acquisition thread idle)
+void resetAcquisitionClock()
 {
-    if (a.size() != b.size())
-    {
-        calcError = -1;
-        return 0.0f;
-    }
-
-    float sum_a = 0, sum_b = 0, sum_ab = 0, sq_sum_a = 0, sq_sum_b = 0;
-
-    for (size_t i = 0; i < a.size(); ++i)
-    {
-        sum_a += a[i];
-        sum_b += b[i];
-        sum_ab += a[i] * b[i];
-        sq_sum_a += a[i] * a[i];
-        sq_sum_b += b[i] * b[i];
-    }
-
-    size_t n = a.size();
-
-    float numerator = n * sum_ab - sum_a * sum_b;
-    float denominator = sqrt((n * sq_sum_a - sum_a * sum_a) * (n * sq_sum_b - sum_b * sum_b));
-
-    return numerator / denominator;
+    acqClock.drained = 0;
+    acqClock.anchor_index = 0;
+    acqClock.anchor_us = 0;
+    acqClock.anchored = false;
+    acqClock.period_us = CAPTURE_PERIOD_US;
+    resetIntervalHistogram(periodHist, PERIOD_HIST_BIN_US);
+    resetIntervalHistogram(latencyHist, LATENCY_HIST_BIN_US);
 }
 
-// Calculate correlation values for x, y, z dimensions of two datasets
-array<float, 3> calcCorrelationVecs(vector<array<float, 3>> &vec1, vector<array<float, 3>> &vec2)
+// Tag a block read from the FIFO with data-ready times and queue it for the rotation thread.
+// The sensor raises no edge per FIFO sample, so the times inside a block are spaced at the
+// measured period from the watermark sample rather than observed.
+void queueTimedBlock(const RotationSensor_RawValues *block, size_t count, bool fromEdge, uint32_t edgeUs)
 {
-    array<float, 3> result;
+    uint32_t nowUs = readTimestampUs();
 
-    for (int i = 0; i < 3; i++)
+    if (fromEdge)
     {
-        vector<float> a;
-        vector<float> b;
-
-        for (const auto &arr : vec1)
+        // The FIFO was empty after the previous read, so the edge fired as its
+        // FIFO_WATERMARK-th newer sample arrived; the sensor clock spaces the rest
+        uint32_t index = acqClock.drained + FIFO_WATERMARK - 1;
+        if (acqClock.anchored && index > acqClock.anchor_index)
         {
-            a.push_back(arr[i]);
-        }
-        for (const auto &arr : vec2)
-        {
-            b.push_back(arr[i]);
+            acqClock.period_us = (float)(edgeUs - acqClock.anchor_us) / (index - acqClock.anchor_index);
+            addInterval(periodHist, (uint32_t)acqClock.period_us);
         }
+        acqClock.anchor_index = index;
+        acqClock.anchor_us = edgeUs;
+        acqClock.anchored = true;
+        addInterval(latencyHist, nowUs - edgeUs);
+    }
 
-        if (a.size() > b.size())
+    for (size_t i = 0; i < count; i++)
+    {
+        TimedSample s;
+        s.raw = block[i];
+        if (acqClock.anchored)
         {
-            a.resize(b.size(), 0);
+            int32_t offset = (int32_t)(acqClock.drained + i) - (int32_t)acqClock.anchor_index;
+            s.t_us = acqClock.anchor_us + (int32_t)(offset * acqClock.period_us);
         }
-        else if (b.size() > a.size())
+        else
         {
-            b.resize(a.size(), 0);
+            s.t_us = nowUs - (uint32_t)((count - 1 - i) * acqClock.period_us);
         }
-
-        result[i] = calcCorrelation(a, b);
+        sampleRing.push(s);
     }
-
-    return result;
+    acqClock.drained += count;
 }
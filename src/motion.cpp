@@ -2,7 +2,30 @@
 #include "motion.h" 
 #include "constants.h"
 
+// SPI clock for register access, and the faster clock used for block reads
+#define ROTATION_SPI_FREQUENCY      1000000
+#define ROTATION_SPI_FAST_FREQUENCY 8000000
+
+// Calibration stops once the 95% confidence interval of every axis mean is within
+// CALIBRATION_CI_DPS (converted to counts at the configured full scale), after at least
+// MIN and at most MAX samples. The target is absolute, so the count needed grows with
+// the square of the noise: at 500 dps (~2.9 counts) an axis with sigma = 4 counts stops
+// at MIN, sigma = 10 after ~47 samples, and sigma above ~23 runs to the cap (~1.3 s at
+// 200 Hz). The noise threshold of each axis is CALIBRATION_SIGMA_K standard deviations.
+#define CALIBRATION_MIN_SAMPLES 16
+#define CALIBRATION_MAX_SAMPLES 256
+#define CALIBRATION_CI_DPS      0.05f
+#define CALIBRATION_Z_95        1.96f
+#define CALIBRATION_SIGMA_K     3.0f
+
+// Bytes in one block transfer: command byte plus six data bytes per FIFO sample
+#define ROTATION_BLOCK_BYTES (1 + 6 * FIFO_DEPTH)
+
 SPI rotation_sensor_spi(PF_9, PF_8, PF_7); // mosi, miso, sclk
+// Second handle on the same bus for FIFO block bursts. Mbed reapplies a handle's
+// format and clock whenever it takes the bus over, so register access through
+// rotation_sensor_spi always runs at ROTATION_SPI_FREQUENCY.
+SPI rotation_block_spi(PF_9, PF_8, PF_7);
 DigitalOut cs_line(PC_1);
 
 // Axis calibration thresholds
@@ -17,7 +40,19 @@ int16_t z_axis_sample;
 
 float sensitivity = 0.0f;
 
-RotationSensor_RawValues *rotation_values; // pointer to hold raw sensor data
+uint32_t fifo_overruns = 0; // FIFO overruns since the FIFO was enabled
+
+RotationSensor_ReadStats read_stats = {0, 0, 0, 0}; // Status+data reads this session
+
+// Ping-pong buffers for asynchronous block reads. Block k lives in half k & 1;
+// the counters are only ever incremented, each by a single context.
+uint8_t block_tx[ROTATION_BLOCK_BYTES];
+uint8_t block_rx[2][ROTATION_BLOCK_BYTES];
+size_t block_samples[2];
+uint32_t blocks_started = 0;            // Transfers issued (acquisition thread)
+volatile uint32_t blocks_filled = 0;    // Transfers completed (transfer-complete ISR)
+volatile uint32_t blocks_consumed = 0;  // Blocks handed to the consumer
+void (*block_done_handler)() = NULL;    // Called from the ISR when a block is full
 
 // Write a single byte to the rotation sensor
 void Transmitter_WriteByte(uint8_t address, uint8_t data)
@@ -28,49 +63,127 @@ void Transmitter_WriteByte(uint8_t address, uint8_t data)
   cs_line = 1;
 }
 
-// Retrieve raw rotation data from the sensor
-void RetrieveRotationData(RotationSensor_RawValues *rawdata)
+// Read a single byte from the rotation sensor
+uint8_t Transmitter_ReadByte(uint8_t address)
 {
   cs_line = 0;
-  // Using renamed register for X-axis low byte, preserving SPI read flags
-  rotation_sensor_spi.write(X_AXIS_LOW_DATA_REG | 0x80 | 0x40); // auto-increment read
-  rawdata->x_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
-  rawdata->y_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
-  rawdata->z_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
+  rotation_sensor_spi.write(address | SPI_READ_FLAG);
+  uint8_t data = rotation_sensor_spi.write(0xff);
   cs_line = 1;
+  return data;
+}
+
+// Read the status register and the sample in one burst and classify the sample
+RotationSensor_SampleStatus RetrieveRotationSample(RotationSensor_RawValues *rawdata)
+{
+  uint8_t frame[7];
+
+  // Auto-increment walks 0x27 (status) then 0x28-0x2D (X, Y, Z); the status is
+  // latched with the data, so it describes exactly the sample returned
+  cs_line = 0;
+  rotation_sensor_spi.write(DATA_STATUS_REG | SPI_READ_FLAG | SPI_AUTO_INCREMENT_FLAG);
+  for (int i = 0; i < 7; i++)
+    frame[i] = rotation_sensor_spi.write(0xff);
+  cs_line = 1;
+
+  rawdata->x_axis_value = frame[1] | (frame[2] << 8);
+  rawdata->y_axis_value = frame[3] | (frame[4] << 8);
+  rawdata->z_axis_value = frame[5] | (frame[6] << 8);
+
+  read_stats.reads++;
+  if (!(frame[0] & DATA_STATUS_XYZ_READY))
+  {
+    read_stats.duplicates++;
+    return ROTATION_SAMPLE_DUPLICATE;
+  }
+
+  read_stats.fresh++;
+  if (frame[0] & DATA_STATUS_XYZ_OVERRUN)
+  {
+    read_stats.overruns++;
+    return ROTATION_SAMPLE_OVERRUN;
+  }
+  return ROTATION_SAMPLE_NEW;
+}
+
+// Clear the session counters
+void ResetRotationReadStats()
+{
+  read_stats.reads = 0;
+  read_stats.fresh = 0;
+  read_stats.duplicates = 0;
+  read_stats.overruns = 0;
+}
+
+// Session counters for RetrieveRotationSample
+const RotationSensor_ReadStats *GetRotationReadStats()
+{
+  return &read_stats;
 }
 
 // Execute a calibration routine on the rotation sensor
-void CalibrateRotationSensor(RotationSensor_RawValues *rawdata)
+uint32_t CalibrateRotationSensor(RotationSensor_RawValues *rawdata)
 {
-  int16_t sumX = 0;
-  int16_t sumY = 0;
-  int16_t sumZ = 0;
-  for (int i = 0; i < 128; i++)
+  int32_t sum[3] = {0, 0, 0};
+  int64_t sq_sum[3] = {0, 0, 0};
+  float sigma[3] = {0, 0, 0};
+  uint32_t n = 0;
+  float target = CALIBRATION_CI_DPS / sensitivity;
+
+  ResetRotationReadStats();
+  while (n < CALIBRATION_MAX_SAMPLES)
   {
-    RetrieveRotationData(rawdata);
-    sumX += rawdata->x_axis_value;
-    sumY += rawdata->y_axis_value;
-    sumZ += rawdata->z_axis_value;
-    x_axis_threshold = max(x_axis_threshold, rawdata->x_axis_value);
-    y_axis_threshold = max(y_axis_threshold, rawdata->y_axis_value);
-    z_axis_threshold = max(z_axis_threshold, rawdata->z_axis_value);
-    wait_us(10000);
+    // Duplicates would shrink the variance, so only fresh samples are counted; give
+    // up waiting after about one 100 Hz period and accept whatever is there
+    int polls = 0;
+    while (RetrieveRotationSample(rawdata) == ROTATION_SAMPLE_DUPLICATE && ++polls < 20)
+      wait_us(500);
+
+    int16_t v[3] = {rawdata->x_axis_value, rawdata->y_axis_value, rawdata->z_axis_value};
+    for (int k = 0; k < 3; k++)
+    {
+      sum[k] += v[k];
+      sq_sum[k] += (int32_t)v[k] * v[k];
+    }
+    n++;
+
+    if (n < CALIBRATION_MIN_SAMPLES)
+      continue;
+
+    // Running variance from the exact integer sums; stop once every mean is pinned down
+    bool settled = true;
+    for (int k = 0; k < 3; k++)
+    {
+      int64_t spread = (int64_t)n * sq_sum[k] - (int64_t)sum[k] * sum[k];
+      sigma[k] = sqrtf((float)spread / ((float)n * (n - 1)));
+      if (CALIBRATION_Z_95 * sigma[k] / sqrtf((float)n) > target)
+        settled = false;
+    }
+    if (settled)
+      break;
   }
 
-  x_axis_sample = sumX >> 7; // 128 is 2^7
-  y_axis_sample = sumY >> 7;
-  z_axis_sample = sumZ >> 7;
+  // Round the means to the nearest count
+  x_axis_sample = (int16_t)lrintf((float)sum[0] / n);
+  y_axis_sample = (int16_t)lrintf((float)sum[1] / n);
+  z_axis_sample = (int16_t)lrintf((float)sum[2] / n);
+
+  x_axis_threshold = (int16_t)ceilf(CALIBRATION_SIGMA_K * sigma[0]);
+  y_axis_threshold = (int16_t)ceilf(CALIBRATION_SIGMA_K * sigma[1]);
+  z_axis_threshold = (int16_t)ceilf(CALIBRATION_SIGMA_K * sigma[2]);
+
+  return n;
 }
 
-// Initialize the rotation sensor with given parameters
-void InitializeRotationSensor(RotationSensor_Init_Params *init_parameters, RotationSensor_RawValues *init_raw_data)
+// Set up the SPI bus and sensor registers without recalibrating
+void ConfigureRotationSensor(RotationSensor_Init_Params *init_parameters)
 {
-  rotation_values = init_raw_data;
   cs_line = 1;
   // set up rotation sensor
   rotation_sensor_spi.format(8, 3);       // 8 bits per SPI frame; polarity 1, phase 0
-  rotation_sensor_spi.frequency(1000000); // 1 MHz SPI clock frequency
+  rotation_sensor_spi.frequency(ROTATION_SPI_FREQUENCY); // 1 MHz SPI clock frequency
+  rotation_block_spi.format(8, 3);
+  rotation_block_spi.frequency(ROTATION_SPI_FAST_FREQUENCY);
 
   // Configure sensor registers using the updated structure fields
   Transmitter_WriteByte(ODR_BW_CTRL_REG, init_parameters->sampling_rate_conf | DEVICE_POWER_ON); 
@@ -95,8 +208,28 @@ void InitializeRotationSensor(RotationSensor_Init_Params *init_parameters, Rotat
       sensitivity = SENSITIVITY_2000_DPS_PER_DIGIT;
       break;
   }
+}
 
-  CalibrateRotationSensor(rotation_values); 
+// Read the calibration applied by ApplyRotationCalibration
+void GetRotationCalibration(RotationSensor_Calibration *cal)
+{
+  cal->offset[0] = x_axis_sample;
+  cal->offset[1] = y_axis_sample;
+  cal->offset[2] = z_axis_sample;
+  cal->threshold[0] = x_axis_threshold;
+  cal->threshold[1] = y_axis_threshold;
+  cal->threshold[2] = z_axis_threshold;
+}
+
+// Replace the calibration, e.g. with one restored from flash or refined while idle
+void SetRotationCalibration(const RotationSensor_Calibration *cal)
+{
+  x_axis_sample = cal->offset[0];
+  y_axis_sample = cal->offset[1];
+  z_axis_sample = cal->offset[2];
+  x_axis_threshold = cal->threshold[0];
+  y_axis_threshold = cal->threshold[1];
+  z_axis_threshold = cal->threshold[2];
 }
 
 // Convert raw data to degrees per second
@@ -106,42 +239,234 @@ float RawToDPS(int16_t axis_data)
   return dps;
 }
 
-// Convert degrees per second to linear velocity (m/s)
-float DPSToLinearVelocity(int16_t axis_data)
+// Apply the zero-rate offsets and noise thresholds to a raw sample
+void ApplyRotationCalibration(RotationSensor_RawValues *values)
 {
-  float velocity = axis_data * sensitivity * DEGREES_TO_RADIANS * MOUNT_POSITION;
-  return velocity;
+  // Offset the zero rate level
+  values->x_axis_value -= x_axis_sample;
+  values->y_axis_value -= y_axis_sample;
+  values->z_axis_value -= z_axis_sample;
+
+  // Apply threshold filtering
+  if (abs(values->x_axis_value) < abs(x_axis_threshold))
+    values->x_axis_value = 0;
+  if (abs(values->y_axis_value) < abs(y_axis_threshold))
+    values->y_axis_value = 0;
+  if (abs(values->z_axis_value) < abs(z_axis_threshold))
+    values->z_axis_value = 0;
 }
 
-// Compute total travel distance from an array of raw values
-float ComputeTravelDistance(int16_t arr[])
+// Switch the FIFO to stream mode with a watermark interrupt on INT2
+void EnableRotationFIFO(uint8_t watermark)
 {
-  float distance = 0.00f;
-  for (int i = 0; i < 400; i++)
+  fifo_overruns = 0;
+
+  // Start from an empty FIFO: passing through bypass mode discards its contents
+  Transmitter_WriteByte(FIFO_CTRL_CONFIG_REG, FIFO_MODE_BYPASS);
+  Transmitter_WriteByte(ADV_FEATURES_CTRL_REG, FIFO_ENABLE);
+  Transmitter_WriteByte(FIFO_CTRL_CONFIG_REG, FIFO_MODE_STREAM | (watermark & FIFO_WATERMARK_MASK));
+  Transmitter_WriteByte(INTERRUPT_CTRL_REG, INT2_FIFO_WATERMARK | INT2_FIFO_OVERRUN);
+}
+
+// Return the FIFO to bypass mode with the data-ready interrupt on INT2
+void DisableRotationFIFO(uint8_t irq_conf)
+{
+  Transmitter_WriteByte(INTERRUPT_CTRL_REG, irq_conf);
+  Transmitter_WriteByte(FIFO_CTRL_CONFIG_REG, FIFO_MODE_BYPASS);
+  Transmitter_WriteByte(ADV_FEATURES_CTRL_REG, 0x00);
+}
+
+// Number of unread FIFO samples, counting an overrun if one occurred
+static size_t ReadRotationFIFOLevel()
+{
+  uint8_t status = Transmitter_ReadByte(FIFO_STATUS_REG);
+
+  // On overrun the FIFO is full and the oldest sample has been lost
+  if (status & FIFO_STATUS_OVERRUN)
   {
-    float v = DPSToLinearVelocity(arr[i]);
-    distance += fabsf(v * 0.05f);
+    fifo_overruns++;
+    return FIFO_DEPTH;
   }
-  return distance;
+  if (status & FIFO_STATUS_EMPTY)
+    return 0;
+  return status & FIFO_STATUS_LEVEL_MASK;
 }
 
-// Retrieve calibrated rotation data
-void FetchCalibratedRotationData()
+// Drain up to max_samples raw samples from the FIFO in one burst
+size_t ReadRotationFIFO(RotationSensor_RawValues *buffer, size_t max_samples)
 {
-  RetrieveRotationData(rotation_values);
+  size_t level = ReadRotationFIFOLevel();
+  if (level > max_samples)
+    level = max_samples;
+  if (level == 0)
+    return 0;
 
-  // Offset the zero rate level
-  rotation_values->x_axis_value -= x_axis_sample;
-  rotation_values->y_axis_value -= y_axis_sample;
-  rotation_values->z_axis_value -= z_axis_sample;
+  // With the FIFO enabled the read address wraps from Z high back to X low,
+  // so one auto-increment transaction returns consecutive samples
+  cs_line = 0;
+  rotation_sensor_spi.write(X_AXIS_LOW_DATA_REG | SPI_READ_FLAG | SPI_AUTO_INCREMENT_FLAG);
+  for (size_t i = 0; i < level; i++)
+  {
+    buffer[i].x_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
+    buffer[i].y_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
+    buffer[i].z_axis_value = rotation_sensor_spi.write(0xff) | (rotation_sensor_spi.write(0xff) << 8);
+  }
+  cs_line = 1;
 
-  // Apply threshold filtering
-  if (abs(rotation_values->x_axis_value) < abs(x_axis_threshold))
-    rotation_values->x_axis_value = 0;
-  if (abs(rotation_values->y_axis_value) < abs(y_axis_threshold))
-    rotation_values->y_axis_value = 0;
-  if (abs(rotation_values->z_axis_value) < abs(z_axis_threshold))
-    rotation_values->z_axis_value = 0;
+  return level;
+}
+
+// FIFO overruns seen since EnableRotationFIFO
+uint32_t GetRotationFIFOOverruns()
+{
+  return fifo_overruns;
+}
+
+// Arm motion wake at the lowest ODR with the FIFO holding the pre-trigger history
+void ArmRotationMotionWake(float threshold_dps, uint8_t duration)
+{
+  int32_t counts = (int32_t)(threshold_dps / sensitivity);
+  if (counts > INT1_THRESHOLD_MAX)
+    counts = INT1_THRESHOLD_MAX;
+
+  Transmitter_WriteByte(ODR_BW_CTRL_REG, ODR_100HZ_CUTOFF_12_5HZ | DEVICE_POWER_ON);
+
+  // Stream-to-FIFO mode keeps the newest FIFO_DEPTH samples streaming until the INT1
+  // event, then stops, so the onset survives however late the MCU reads it.
+  // INT1 compares the raw output, zero-rate offset included, so it is fed through the
+  // high-pass filter instead; the FIFO and output registers still get unfiltered data.
+  Transmitter_WriteByte(HIGH_PASS_FILTER_CTRL_REG, HPF_NORMAL_100HZ_CUTOFF_0_1HZ);
+  Transmitter_WriteByte(FIFO_CTRL_CONFIG_REG, FIFO_MODE_BYPASS);
+  Transmitter_WriteByte(ADV_FEATURES_CTRL_REG, FIFO_ENABLE | HPF_ENABLE | INT1_SEL_HPF);
+  Transmitter_WriteByte(FIFO_CTRL_CONFIG_REG, FIFO_MODE_STREAM_TO_FIFO);
+  // Start the filter from the current rate rather than letting the offset decay through it
+  Transmitter_ReadByte(REFERENCE_REG);
+
+  // The threshold applies to the offset-free rate on each axis
+  const uint8_t high_regs[3] = {INT1_X_THRESHOLD_HIGH_REG, INT1_Y_THRESHOLD_HIGH_REG, INT1_Z_THRESHOLD_HIGH_REG};
+  const uint8_t low_regs[3] = {INT1_X_THRESHOLD_LOW_REG, INT1_Y_THRESHOLD_LOW_REG, INT1_Z_THRESHOLD_LOW_REG};
+  for (int k = 0; k < 3; k++)
+  {
+    Transmitter_WriteByte(high_regs[k], (counts >> 8) & 0x7F);
+    Transmitter_WriteByte(low_regs[k], counts & 0xFF);
+  }
+  Transmitter_WriteByte(INT1_DURATION_REG, duration & INT1_DURATION_MASK);
+  Transmitter_WriteByte(INT1_CONFIG_REG, INT1_CONFIG_LATCH | INT1_X_HIGH_ENABLE | INT1_Y_HIGH_ENABLE | INT1_Z_HIGH_ENABLE);
+
+  // Discard any event latched before arming, then route INT1 to its pin with INT2 quiet
+  Transmitter_ReadByte(INT1_SOURCE_REG);
+  Transmitter_WriteByte(INTERRUPT_CTRL_REG, INT1_PIN_ENABLE);
+}
+
+// Drain the FIFO while armed
+size_t ReadRotationMotionHistory(RotationSensor_RawValues *buffer, size_t max_samples)
+{
+  size_t count = ReadRotationFIFO(buffer, max_samples);
+
+  // A full FIFO is the normal state while armed, not a lost capture sample
+  fifo_overruns = 0;
+  return count;
+}
+
+// Disarm motion wake and restore the capture configuration
+size_t DisarmRotationMotionWake(RotationSensor_Init_Params *init_parameters, RotationSensor_RawValues *history, size_t max_samples)
+{
+  Transmitter_WriteByte(INTERRUPT_CTRL_REG, init_parameters->irq_conf);
+  Transmitter_WriteByte(INT1_CONFIG_REG, 0x00);
+  Transmitter_ReadByte(INT1_SOURCE_REG);
+
+  size_t count = ReadRotationMotionHistory(history, max_samples);
+
+  // Clearing the FIFO features also takes INT1 off the high-pass filter
+  DisableRotationFIFO(init_parameters->irq_conf);
+  Transmitter_WriteByte(HIGH_PASS_FILTER_CTRL_REG, HPF_DISABLED_200HZ);
+  Transmitter_WriteByte(ODR_BW_CTRL_REG, init_parameters->sampling_rate_conf | DEVICE_POWER_ON);
+  return count;
+}
+
+// Transfer-complete handler for block reads (interrupt context)
+static void OnRotationBlockTransferred(int event)
+{
+  cs_line = 1;
+  blocks_filled = blocks_filled + 1;
+  if (block_done_handler)
+    block_done_handler();
+}
+
+// Enable the FIFO and prepare asynchronous block reads; only the bursts use the fast clock
+void EnableRotationBlockReads(uint8_t watermark, void (*on_block)())
+{
+  EnableRotationFIFO(watermark);
+
+  blocks_started = 0;
+  blocks_filled = 0;
+  blocks_consumed = 0;
+  block_done_handler = on_block;
+
+  // The command byte is followed by dummy bytes clocking out the samples
+  memset(block_tx, 0xff, sizeof(block_tx));
+  block_tx[0] = X_AXIS_LOW_DATA_REG | SPI_READ_FLAG | SPI_AUTO_INCREMENT_FLAG;
+
+#if DEVICE_SPI_ASYNCH
+  rotation_block_spi.set_dma_usage(DMA_USAGE_ALWAYS);
+#endif
+}
+
+// Stop block reads and return the sensor to data-ready mode
+void DisableRotationBlockReads(uint8_t irq_conf)
+{
+  DisableRotationFIFO(irq_conf);
+}
+
+// Start reading the FIFO contents into the free half of the ping-pong buffer
+int StartRotationBlockRead()
+{
+  if (blocks_started != blocks_filled)
+    return ROTATION_BLOCK_BUSY;
+  if (blocks_started - blocks_consumed >= 2)
+    return ROTATION_BLOCK_FULL;
+
+  size_t level = ReadRotationFIFOLevel();
+  if (level == 0)
+    return ROTATION_BLOCK_EMPTY;
+
+  uint32_t half = blocks_started & 1;
+  int length = 1 + 6 * level;
+  block_samples[half] = level;
+  blocks_started++;
+
+  cs_line = 0;
+#if DEVICE_SPI_ASYNCH
+  // The DMA moves the whole block; the CPU is free until the completion interrupt
+  rotation_block_spi.transfer(block_tx, length, block_rx[half], length, callback(OnRotationBlockTransferred), SPI_EVENT_COMPLETE);
+#else
+  rotation_block_spi.write((const char *)block_tx, length, (char *)block_rx[half], length);
+  OnRotationBlockTransferred(SPI_EVENT_COMPLETE);
+#endif
+  return ROTATION_BLOCK_STARTED;
+}
+
+// Copy the oldest full block out of the ping-pong buffer and release its half
+size_t ReadRotationBlock(RotationSensor_RawValues *buffer, size_t max_samples)
+{
+  if (blocks_consumed == blocks_filled)
+    return 0;
+
+  uint32_t half = blocks_consumed & 1;
+  size_t count = block_samples[half];
+  if (count > max_samples)
+    count = max_samples;
+
+  const uint8_t *data = &block_rx[half][1];
+  for (size_t i = 0; i < count; i++, data += 6)
+  {
+    buffer[i].x_axis_value = data[0] | (data[1] << 8);
+    buffer[i].y_axis_value = data[2] | (data[3] << 8);
+    buffer[i].z_axis_value = data[4] | (data[5] << 8);
+  }
+
+  blocks_consumed = blocks_consumed + 1;
+  return count;
 }
 
 // Turn off the rotation sensor
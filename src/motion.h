@@ -1,3 +1,9 @@
+#ifndef __MOTION_H
+#define __MOTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
 // Initialization parameters for rotation sensor
 typedef struct
 {
@@ -22,29 +28,108 @@ typedef struct
     int16_t z_axis_cal; // Calibrated Z-axis data
 } RotationSensor_CalibratedValues;
 
+// Outcome of a status+data read
+typedef enum
+{
+    ROTATION_SAMPLE_NEW,       // Fresh sample, none lost since the previous read
+    ROTATION_SAMPLE_OVERRUN,   // Fresh sample, but at least one earlier sample was overwritten unread
+    ROTATION_SAMPLE_DUPLICATE  // No new data since the previous read; values are stale
+} RotationSensor_SampleStatus;
+
+// Per-session accounting of status+data reads
+typedef struct
+{
+    uint32_t reads;      // Transactions issued
+    uint32_t fresh;      // Reads that returned a new sample
+    uint32_t duplicates; // Reads that returned stale data
+    uint32_t overruns;   // Reads that found ZYXOR set (one or more samples missed each)
+} RotationSensor_ReadStats;
+
+// Zero-rate level and noise threshold of each axis, in raw counts
+typedef struct
+{
+    int16_t offset[3];    // Subtracted from every sample
+    int16_t threshold[3]; // Offset-corrected samples below this are zeroed
+} RotationSensor_Calibration;
+
 // Write a single byte to the sensor
 void Transmitter_WriteByte(uint8_t address, uint8_t data);
 
-// Retrieve raw rotation data from the sensor
-void RetrieveRotationData(RotationSensor_RawValues *rawdata);
+// Read a single byte from the sensor
+uint8_t Transmitter_ReadByte(uint8_t address);
+
+// Read the status register and the sample in one burst from DATA_STATUS_REG, and
+// classify the sample; the outcome is added to the session counters
+RotationSensor_SampleStatus RetrieveRotationSample(RotationSensor_RawValues *rawdata);
+
+// Session counters for RetrieveRotationSample
+void ResetRotationReadStats();
+const RotationSensor_ReadStats *GetRotationReadStats();
 
-// Execute a calibration routine on the rotation sensor
-void CalibrateRotationSensor(RotationSensor_RawValues *rawdata);
+// Estimate the zero-rate offsets and noise thresholds with the board at rest, stopping
+// once each offset is known to within a fixed fraction of a dps, so a quiet sensor stops
+// early and a noisy one averages more samples; returns the samples used
+uint32_t CalibrateRotationSensor(RotationSensor_RawValues *rawdata);
 
-// Initialize the rotation sensor with given parameters
-void InitializeRotationSensor(RotationSensor_Init_Params *init_parameters, RotationSensor_RawValues *init_raw_data);
+// Set up the SPI bus and sensor registers without recalibrating
+void ConfigureRotationSensor(RotationSensor_Init_Params *init_parameters);
+
+// Read or replace the calibration applied by ApplyRotationCalibration
+void GetRotationCalibration(RotationSensor_Calibration *cal);
+void SetRotationCalibration(const RotationSensor_Calibration *cal);
 
 // Convert raw data to degrees per second
 float RawToDPS(int16_t rawdata);
 
-// Convert degrees per second to linear velocity (m/s)
-float DPSToLinearVelocity(int16_t rawdata);
+// Apply the zero-rate offsets and noise thresholds to a raw sample
+void ApplyRotationCalibration(RotationSensor_RawValues *values);
+
+// Switch the FIFO to stream mode with a watermark interrupt on INT2 (1-31 samples)
+void EnableRotationFIFO(uint8_t watermark);
+
+// Return the FIFO to bypass mode with the data-ready interrupt on INT2
+void DisableRotationFIFO(uint8_t irq_conf);
+
+// Drain up to max_samples raw samples from the FIFO in one burst; returns the count read
+size_t ReadRotationFIFO(RotationSensor_RawValues *buffer, size_t max_samples);
+
+// FIFO overruns seen since EnableRotationFIFO
+uint32_t GetRotationFIFOOverruns();
+
+// Results of StartRotationBlockRead
+#define ROTATION_BLOCK_STARTED 1  // Transfer issued; on_block runs when it completes
+#define ROTATION_BLOCK_EMPTY   0  // FIFO has nothing to read
+#define ROTATION_BLOCK_FULL    -1 // Both ping-pong halves await the consumer
+#define ROTATION_BLOCK_BUSY    -2 // A transfer is still in flight
 
-// Compute total travel distance from an array of raw values
-float ComputeTravelDistance(int16_t arr[]);
+// Enable the FIFO and asynchronous (DMA) block reads; on_block runs in interrupt
+// context each time a block has been transferred
+void EnableRotationBlockReads(uint8_t watermark, void (*on_block)());
 
-// Retrieve calibrated rotation data
-void FetchCalibratedRotationData();
+// Stop block reads and return the sensor to data-ready mode
+void DisableRotationBlockReads(uint8_t irq_conf);
+
+// Start reading the whole FIFO into the free half of the ping-pong buffer
+int StartRotationBlockRead();
+
+// Copy the oldest full block (up to max_samples) and release its half; returns the
+// sample count, or 0 if no block is ready
+size_t ReadRotationBlock(RotationSensor_RawValues *buffer, size_t max_samples);
+
+// Arm motion wake: drop to the lowest ODR, keep the newest samples streaming through
+// the FIFO as pre-trigger history, and raise INT1 once the high-pass filtered rate of
+// any axis (so its zero-rate offset is ignored) exceeds threshold_dps for duration samples.
+// The FIFO stops filling at the INT1 event, keeping the history up to the trigger.
+void ArmRotationMotionWake(float threshold_dps, uint8_t duration);
+
+// Drain the FIFO while armed (oldest sample first); returns the count read
+size_t ReadRotationMotionHistory(RotationSensor_RawValues *buffer, size_t max_samples);
+
+// Disarm motion wake and restore the capture configuration; the pre-trigger history
+// still in the FIFO is returned oldest first
+size_t DisarmRotationMotionWake(RotationSensor_Init_Params *init_parameters, RotationSensor_RawValues *history, size_t max_samples);
 
 // Turn off the rotation sensor
 void DeactivateSensor();
+
+#endif
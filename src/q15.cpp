@@ -0,0 +1,475 @@
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "q15.h"
+#include "dtw.h"
+
+#if Q15_USE_DSP
+#include "cmsis.h"
+#endif
+
+// Rolling rows of the integer warping matrix (rotation thread only)
+static uint32_t q15RowPrev[MAX_GESTURE_SAMPLES + 1];
+static uint32_t q15RowCurr[MAX_GESTURE_SAMPLES + 1];
+
+// Column samples repacked as (x | y << 16) words for the dual 16-bit instructions
+static uint32_t q15ColXY[MAX_GESTURE_SAMPLES];
+
+// Sums needed for the Pearson correlation of one axis
+typedef struct
+{
+    int32_t sum_a;
+    int32_t sum_b;
+    int64_t sum_ab;
+    int64_t sq_sum_a;
+    int64_t sq_sum_b;
+} CorrelationSumsQ15;
+
+// Pack two int16 values into one word, first value in the low halfword
+static inline uint32_t pack16(int16_t lo, int16_t hi)
+{
+    return (uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+}
+
+// Integer square root (floor) of a 64-bit value
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (v >= root + bit)
+        {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+// Accumulate the correlation sums of two int16 sequences
+static void accumulateSumsQ15(const int16_t *a, const int16_t *b, size_t n, CorrelationSumsQ15 &acc)
+{
+    size_t i = 0;
+
+#if Q15_USE_DSP
+    // Two samples per instruction: SMLAD against (1, 1) for sums, SMLALD for products
+    for (; i + 1 < n; i += 2)
+    {
+        uint32_t wa, wb;
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+
+        acc.sum_a = (int32_t)__SMLAD(wa, 0x00010001u, (uint32_t)acc.sum_a);
+        acc.sum_b = (int32_t)__SMLAD(wb, 0x00010001u, (uint32_t)acc.sum_b);
+        acc.sum_ab = (int64_t)__SMLALD(wa, wb, (uint64_t)acc.sum_ab);
+        acc.sq_sum_a = (int64_t)__SMLALD(wa, wa, (uint64_t)acc.sq_sum_a);
+        acc.sq_sum_b = (int64_t)__SMLALD(wb, wb, (uint64_t)acc.sq_sum_b);
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        acc.sum_a += a[i];
+        acc.sum_b += b[i];
+        acc.sum_ab += (int32_t)a[i] * b[i];
+        acc.sq_sum_a += (int32_t)a[i] * a[i];
+        acc.sq_sum_b += (int32_t)b[i] * b[i];
+    }
+}
+
+// Accumulate only the sums that involve b, for a key whose own sums are cached
+static void accumulateCrossSumsQ15(const int16_t *a, const int16_t *b, size_t n, CorrelationSumsQ15 &acc)
+{
+    size_t i = 0;
+
+#if Q15_USE_DSP
+    for (; i + 1 < n; i += 2)
+    {
+        uint32_t wa, wb;
+        memcpy(&wa, a + i, sizeof(wa));
+        memcpy(&wb, b + i, sizeof(wb));
+
+        acc.sum_b = (int32_t)__SMLAD(wb, 0x00010001u, (uint32_t)acc.sum_b);
+        acc.sum_ab = (int64_t)__SMLALD(wa, wb, (uint64_t)acc.sum_ab);
+        acc.sq_sum_b = (int64_t)__SMLALD(wb, wb, (uint64_t)acc.sq_sum_b);
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        acc.sum_b += b[i];
+        acc.sum_ab += (int32_t)a[i] * b[i];
+        acc.sq_sum_b += (int32_t)b[i] * b[i];
+    }
+}
+
+// Pearson correlation as Q15 from the numerator and the two per-axis norms
+static int16_t correlationQ15(int64_t numerator, uint32_t norm_a, uint32_t norm_b)
+{
+    int64_t r = numerator * Q15_ONE / ((int64_t)norm_a * norm_b);
+
+    // Truncated square roots can push |r| marginally past 1.0
+    if (r > INT16_MAX)
+    {
+        r = INT16_MAX;
+    }
+    else if (r < INT16_MIN)
+    {
+        r = INT16_MIN;
+    }
+    return (int16_t)r;
+}
+
+// Cell cost in counts from a sum of squared halved differences. IEEE sqrt is correctly
+// rounded, so this matches on host and target (VSQRT), and it never decreases as the
+// sum grows, which the lower bounds below rely on.
+static inline uint32_t costQ15(uint32_t sq)
+{
+    return (uint32_t)sqrtf((float)sq) << 1;
+}
+
+// Half-resolution Euclidean distance between two samples, returned in counts
+static inline uint32_t distQ15(uint32_t rowXY, int16_t rowZ, uint32_t colXY, int16_t colZ)
+{
+    uint32_t sq;
+
+#if Q15_USE_DSP
+    uint32_t d = __SHSUB16(rowXY, colXY);
+    sq = __SMUAD(d, d);
+#else
+    int32_t dx = ((int32_t)(int16_t)rowXY - (int16_t)colXY) >> 1;
+    int32_t dy = ((int32_t)(int16_t)(rowXY >> 16) - (int16_t)(colXY >> 16)) >> 1;
+    sq = (uint32_t)(dx * dx) + (uint32_t)(dy * dy);
+#endif
+
+    int32_t dz = ((int32_t)rowZ - colZ) >> 1;
+    sq += (uint32_t)(dz * dz);
+
+    return costQ15(sq);
+}
+
+// Squared halved gap for the lower bounds. Halving |d| rounds down, while the kernels
+// halve the signed difference, so this never exceeds the kernel's term for either order.
+static inline uint32_t boundSqQ15(int32_t gap)
+{
+    uint32_t h = (uint32_t)abs(gap) >> 1;
+    return h * h;
+}
+
+// Lower bound on the cost of the cell pairing sample i of a with sample j of b
+static inline uint32_t boundDistQ15(const GestureQ15 &a, size_t i, const GestureQ15 &b, size_t j)
+{
+    uint32_t sq = 0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        sq += boundSqQ15((int32_t)a.axis[k][i] - b.axis[k][j]);
+    }
+    return costQ15(sq);
+}
+
+// Distance between two samples in counts
+uint32_t calcDistQ15(const std::array<int16_t, 3> &a, const std::array<int16_t, 3> &b)
+{
+    return distQ15(pack16(a[0], a[1]), a[2], pack16(b[0], b[1]), b[2]);
+}
+
+// Per-axis correlation of two gestures over their common length, as Q15
+bool calcCorrelationVecsQ15(const GestureQ15 &a, const GestureQ15 &b, std::array<int16_t, 3> &result)
+{
+    bool valid = true;
+    result = {0, 0, 0};
+    size_t n = (a.length < b.length) ? a.length : b.length;
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        CorrelationSumsQ15 acc = {0, 0, 0, 0, 0};
+        accumulateSumsQ15(a.axis[k], b.axis[k], n, acc);
+
+        int64_t numerator = (int64_t)n * acc.sum_ab - (int64_t)acc.sum_a * acc.sum_b;
+        int64_t var_a = (int64_t)n * acc.sq_sum_a - (int64_t)acc.sum_a * acc.sum_a;
+        int64_t var_b = (int64_t)n * acc.sq_sum_b - (int64_t)acc.sum_b * acc.sum_b;
+
+        // A flat axis has no defined correlation; report it as uncorrelated
+        if (var_a <= 0 || var_b <= 0)
+        {
+            valid = false;
+            continue;
+        }
+
+        result[k] = correlationQ15(numerator, isqrt64((uint64_t)var_a), isqrt64((uint64_t)var_b));
+    }
+
+    return valid;
+}
+
+// Compute the template side of the cached correlation
+void calcCorrelationStatsQ15(const GestureQ15 &key, CorrelationStatsQ15 &stats)
+{
+    stats.length = key.length;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        int32_t sum = 0;
+        int64_t sq_sum = 0;
+        for (size_t i = 0; i < key.length; ++i)
+        {
+            sum += key.axis[k][i];
+            sq_sum += (int32_t)key.axis[k][i] * key.axis[k][i];
+        }
+
+        int64_t var = (int64_t)key.length * sq_sum - (int64_t)sum * sum;
+        stats.sum[k] = sum;
+        stats.norm[k] = (var > 0) ? isqrt64((uint64_t)var) : 0;
+    }
+}
+
+// Per-axis correlation of an attempt against a key with cached sums, as Q15
+bool calcCorrelationCachedQ15(const GestureQ15 &key, const CorrelationStatsQ15 &stats, const GestureQ15 &attempt,
+                              std::array<int16_t, 3> &result)
+{
+    bool valid = true;
+    result = {0, 0, 0};
+    size_t n = stats.length;
+
+    if (key.length != n || attempt.length != n)
+    {
+        return false;
+    }
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        CorrelationSumsQ15 acc = {stats.sum[k], 0, 0, 0, 0};
+        accumulateCrossSumsQ15(key.axis[k], attempt.axis[k], n, acc);
+
+        int64_t numerator = (int64_t)n * acc.sum_ab - (int64_t)acc.sum_a * acc.sum_b;
+        int64_t var_b = (int64_t)n * acc.sq_sum_b - (int64_t)acc.sum_b * acc.sum_b;
+
+        if (stats.norm[k] == 0 || var_b <= 0)
+        {
+            valid = false;
+            continue;
+        }
+
+        result[k] = correlationQ15(numerator, stats.norm[k], isqrt64((uint64_t)var_b));
+    }
+
+    return valid;
+}
+
+// Banded integer DTW with early abandoning
+uint32_t calcDTWQ15(const GestureQ15 &s, const GestureQ15 &t, size_t window, uint32_t threshold)
+{
+    // DTW is symmetric, so let the shorter gesture index the row buffers
+    const GestureQ15 &rows = (s.length >= t.length) ? s : t;
+    const GestureQ15 &cols = (s.length >= t.length) ? t : s;
+    size_t n = rows.length;
+    size_t m = cols.length;
+
+    if (m == 0 || m > MAX_GESTURE_SAMPLES)
+    {
+        return Q15_DTW_INFINITY;
+    }
+
+    for (size_t j = 0; j < m; ++j)
+    {
+        q15ColXY[j] = pack16(cols.axis[0][j], cols.axis[1][j]);
+    }
+
+    uint32_t *prev = q15RowPrev;
+    uint32_t *curr = q15RowCurr;
+
+    prev[0] = 0;
+    for (size_t j = 1; j <= m; ++j)
+    {
+        prev[j] = Q15_DTW_INFINITY;
+    }
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t lo, hi;
+        dtwBandRange(i, n, m, window, lo, hi);
+
+        uint32_t rowXY = pack16(rows.axis[0][i - 1], rows.axis[1][i - 1]);
+        int16_t rowZ = rows.axis[2][i - 1];
+        uint32_t rowMin = Q15_DTW_INFINITY;
+
+        curr[lo - 1] = Q15_DTW_INFINITY;
+        for (size_t j = lo; j <= hi; ++j)
+        {
+            uint32_t best = prev[j];
+            best = (curr[j - 1] < best) ? curr[j - 1] : best;
+            best = (prev[j - 1] < best) ? prev[j - 1] : best;
+
+            curr[j] = (best == Q15_DTW_INFINITY) ? Q15_DTW_INFINITY
+                                                 : best + distQ15(rowXY, rowZ, q15ColXY[j - 1], cols.axis[2][j - 1]);
+            rowMin = (curr[j] < rowMin) ? curr[j] : rowMin;
+        }
+        // Seal the band edge so the next row never reads a stale cell
+        if (hi < m)
+        {
+            curr[hi + 1] = Q15_DTW_INFINITY;
+        }
+
+        if (rowMin > threshold)
+        {
+            return Q15_DTW_INFINITY;
+        }
+
+        uint32_t *swap = prev;
+        prev = curr;
+        curr = swap;
+    }
+
+    return prev[m];
+}
+
+// LB_Kim lower bound from the endpoints and per-axis extrema of both gestures
+uint32_t calcLBKimQ15(const GestureQ15 &s, const GestureQ15 &t)
+{
+    if (s.length == 0 || t.length == 0)
+    {
+        return (s.length == 0 && t.length == 0) ? 0 : Q15_DTW_INFINITY;
+    }
+
+    // First and last cells lie on every warping path
+    uint32_t bound = boundDistQ15(s, 0, t, 0);
+    if (s.length > 1 || t.length > 1)
+    {
+        bound += boundDistQ15(s, s.length - 1, t, t.length - 1);
+    }
+
+    // A sample outside the other gesture's range on some axis costs at least the gap
+    int32_t gap = 0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+        int32_t sLo = s.axis[k][0], sHi = s.axis[k][0];
+        int32_t tLo = t.axis[k][0], tHi = t.axis[k][0];
+        for (size_t i = 1; i < s.length; ++i)
+        {
+            sLo = (s.axis[k][i] < sLo) ? s.axis[k][i] : sLo;
+            sHi = (s.axis[k][i] > sHi) ? s.axis[k][i] : sHi;
+        }
+        for (size_t j = 1; j < t.length; ++j)
+        {
+            tLo = (t.axis[k][j] < tLo) ? t.axis[k][j] : tLo;
+            tHi = (t.axis[k][j] > tHi) ? t.axis[k][j] : tHi;
+        }
+
+        int32_t hiGap = (sHi > tHi) ? sHi - tHi : tHi - sHi;
+        int32_t loGap = (sLo > tLo) ? sLo - tLo : tLo - sLo;
+        gap = (hiGap > gap) ? hiGap : gap;
+        gap = (loGap > gap) ? loGap : gap;
+    }
+
+    uint32_t gapCost = costQ15(boundSqQ15(gap));
+    return (bound > gapCost) ? bound : gapCost;
+}
+
+// Build the LB_Keogh envelope of key for a resampled attempt
+bool calcDTWEnvelopeQ15(const GestureQ15 &key, size_t window, ResampledGesture &upper, ResampledGesture &lower)
+{
+    if (key.length == 0)
+    {
+        return false;
+    }
+
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t a = 0; a < GESTURE_RESAMPLE_LEN; ++a)
+        {
+            upper.axis[k][a] = INT16_MIN;
+            lower.axis[k][a] = INT16_MAX;
+        }
+    }
+
+    // Walk the band with the longer gesture as rows, exactly as the DTW kernel does
+    bool keyIsRows = (key.length >= GESTURE_RESAMPLE_LEN);
+    size_t n = keyIsRows ? key.length : GESTURE_RESAMPLE_LEN;
+    size_t m = keyIsRows ? GESTURE_RESAMPLE_LEN : key.length;
+
+    for (size_t i = 1; i <= n; ++i)
+    {
+        size_t lo, hi;
+        dtwBandRange(i, n, m, window, lo, hi);
+        for (size_t j = lo; j <= hi; ++j)
+        {
+            size_t p = keyIsRows ? i - 1 : j - 1;
+            size_t a = keyIsRows ? j - 1 : i - 1;
+            for (size_t k = 0; k < 3; ++k)
+            {
+                int16_t v = key.axis[k][p];
+                upper.axis[k][a] = (v > upper.axis[k][a]) ? v : upper.axis[k][a];
+                lower.axis[k][a] = (v < lower.axis[k][a]) ? v : lower.axis[k][a];
+            }
+        }
+    }
+
+    return true;
+}
+
+// LB_Keogh lower bound of a resampled attempt against a key envelope
+uint32_t calcLBKeoghQ15(const GestureQ15 &attempt, const ResampledGesture &upper, const ResampledGesture &lower)
+{
+    uint32_t bound = 0;
+    size_t n = (attempt.length < GESTURE_RESAMPLE_LEN) ? attempt.length : GESTURE_RESAMPLE_LEN;
+
+    for (size_t a = 0; a < n; ++a)
+    {
+        // Distance to the box the key spans inside the band around this sample
+        uint32_t sq = 0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            int32_t v = attempt.axis[k][a];
+            if (v > upper.axis[k][a])
+            {
+                sq += boundSqQ15(v - upper.axis[k][a]);
+            }
+            else if (v < lower.axis[k][a])
+            {
+                sq += boundSqQ15(lower.axis[k][a] - v);
+            }
+        }
+        bound += costQ15(sq);
+    }
+    return bound;
+}
+
+// Score an attempt against the key through LB_Kim, LB_Keogh and early-abandoning DTW
+uint32_t scoreDTWCascadeQ15(const GestureQ15 &key, const GestureQ15 &attempt, const ResampledGesture *upper,
+                            const ResampledGesture *lower, size_t window, uint32_t threshold)
+{
+    dtwStats.attempts++;
+
+    if (calcLBKimQ15(key, attempt) > threshold)
+    {
+        dtwStats.kim_pruned++;
+        return Q15_DTW_INFINITY;
+    }
+
+    if (upper != NULL && lower != NULL && calcLBKeoghQ15(attempt, *upper, *lower) > threshold)
+    {
+        dtwStats.keogh_pruned++;
+        return Q15_DTW_INFINITY;
+    }
+
+    uint32_t dist = calcDTWQ15(key, attempt, window, threshold);
+    if (dist > threshold)
+    {
+        dtwStats.dtw_abandoned++;
+        return Q15_DTW_INFINITY;
+    }
+
+    dtwStats.dtw_completed++;
+    return dist;
+}
@@ -0,0 +1,90 @@
+#ifndef __Q15_H
+#define __Q15_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "resample.h"
+
+// Use the Cortex-M4 SIMD dual-MAC instructions when the compiler targets them;
+// otherwise fall back to the portable reference (bit-exact with the DSP path)
+#ifndef Q15_USE_DSP
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define Q15_USE_DSP 1
+#else
+#define Q15_USE_DSP 0
+#endif
+#endif
+
+// Rate of one count of the stored gestures: the sensor LSB at the 500 dps full scale
+// the gyro captures at
+#define Q15_DPS_PER_COUNT SENSITIVITY_500_DPS_PER_DIGIT
+
+// 1.0 in the Q15 correlations
+#define Q15_ONE 32768
+
+// Returned by the distance kernels when the distance exceeds the threshold or cannot be computed
+#define Q15_DTW_INFINITY UINT32_MAX
+
+// Read-only view of a gesture stored as calibrated gyro counts, one contiguous array per axis
+typedef struct
+{
+    const int16_t *axis[3]; // X, Y, Z samples
+    size_t length;          // Number of samples
+} GestureQ15;
+
+// Template side of the correlation, computed once when the template is enrolled
+typedef struct
+{
+    size_t length;    // Samples the sums cover
+    int32_t sum[3];   // Per-axis sum
+    uint32_t norm[3]; // Per-axis floor(sqrt(n * sum(x^2) - sum(x)^2)), 0 for a flat axis
+} CorrelationStatsQ15;
+
+// View of a resampled gesture
+static inline GestureQ15 viewGestureQ15(const ResampledGesture &g)
+{
+    GestureQ15 view = {{g.axis[0], g.axis[1], g.axis[2]}, GESTURE_RESAMPLE_LEN};
+    return view;
+}
+
+// Distance between two samples in counts, as used for one cell of the DTW kernels.
+// Differences are halved so the squared terms of two axes fit one SMUAD result, so the
+// distance comes in steps of 2 counts.
+uint32_t calcDistQ15(const std::array<int16_t, 3> &a, const std::array<int16_t, 3> &b);
+
+// Per-axis correlation of two gestures over their common length, as Q15 (Q15_ONE ~ 1.0).
+// A flat axis reads 0; returns false if an axis of either gesture is flat.
+bool calcCorrelationVecsQ15(const GestureQ15 &a, const GestureQ15 &b, std::array<int16_t, 3> &result);
+
+// Compute the template side of calcCorrelationCachedQ15
+void calcCorrelationStatsQ15(const GestureQ15 &key, CorrelationStatsQ15 &stats);
+
+// Same result as calcCorrelationVecsQ15, with the key's own sums taken from its stats so
+// only the attempt's sums are computed; both gestures must have the length in stats
+bool calcCorrelationCachedQ15(const GestureQ15 &key, const CorrelationStatsQ15 &stats, const GestureQ15 &attempt,
+                              std::array<int16_t, 3> &result);
+
+// Banded DTW distance in counts; returns Q15_DTW_INFINITY as soon as a row minimum
+// exceeds threshold, or if a gesture is empty or the shorter one exceeds MAX_GESTURE_SAMPLES
+uint32_t calcDTWQ15(const GestureQ15 &s, const GestureQ15 &t, size_t window, uint32_t threshold);
+
+// LB_Kim lower bound on calcDTWQ15 from the endpoints and per-axis extrema
+uint32_t calcLBKimQ15(const GestureQ15 &s, const GestureQ15 &t);
+
+// Build the LB_Keogh envelope of key for an attempt of GESTURE_RESAMPLE_LEN samples.
+// Returns false if the key is empty.
+bool calcDTWEnvelopeQ15(const GestureQ15 &key, size_t window, ResampledGesture &upper, ResampledGesture &lower);
+
+// LB_Keogh lower bound on calcDTWQ15 of a resampled attempt against a key envelope
+uint32_t calcLBKeoghQ15(const GestureQ15 &attempt, const ResampledGesture &upper, const ResampledGesture &lower);
+
+// Score an attempt against the key: LB_Kim, then LB_Keogh, then early-abandoning DTW,
+// counted in dtwStats. Returns the banded DTW distance, or Q15_DTW_INFINITY as soon as
+// a stage proves it exceeds threshold. Pass NULL envelopes to skip the LB_Keogh stage.
+uint32_t scoreDTWCascadeQ15(const GestureQ15 &key, const GestureQ15 &attempt, const ResampledGesture *upper,
+                            const ResampledGesture *lower, size_t window, uint32_t threshold);
+
+#endif
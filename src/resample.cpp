@@ -0,0 +1,69 @@
+#include <string.h>
+#include <math.h>
+
+#include "resample.h"
+
+// Point frac of the way from sample i to sample i + 1, rounded to the nearest count
+static inline int16_t lerpCounts(const int16_t *in, size_t i, float frac)
+{
+    return (int16_t)lrintf(in[i] + frac * (in[i + 1] - in[i]));
+}
+
+// Linearly interpolate len samples onto GESTURE_RESAMPLE_LEN evenly spaced points
+void resampleGesture(const int16_t *x, const int16_t *y, const int16_t *z, size_t len, ResampledGesture &out)
+{
+    const int16_t *in[3] = {x, y, z};
+
+    if (len == 0)
+    {
+        memset(&out, 0, sizeof(out));
+        return;
+    }
+
+    // Output sample k sits at input position k * (len - 1) / (N - 1)
+    const float step = (float)(len - 1) / (GESTURE_RESAMPLE_LEN - 1);
+
+    for (size_t k = 0; k < GESTURE_RESAMPLE_LEN; ++k)
+    {
+        float pos = k * step;
+        size_t i = (size_t)pos;
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            out.axis[axis][k] = (i >= len - 1) ? in[axis][len - 1] : lerpCounts(in[axis], i, pos - i);
+        }
+    }
+}
+
+// Linearly interpolate len timestamped samples onto GESTURE_RESAMPLE_LEN points evenly spaced in time
+void resampleGestureTimed(const int16_t *x, const int16_t *y, const int16_t *z, const uint32_t *t_us, size_t len, ResampledGesture &out)
+{
+    if (len < 2 || t_us[len - 1] == t_us[0])
+    {
+        resampleGesture(x, y, z, len, out);
+        return;
+    }
+
+    const int16_t *in[3] = {x, y, z};
+    const float span = (float)(t_us[len - 1] - t_us[0]);
+    size_t i = 0;
+
+    for (size_t k = 0; k < GESTURE_RESAMPLE_LEN; ++k)
+    {
+        // Offsets from the first sample, so a timer wrap inside the gesture is harmless
+        float target = k * span / (GESTURE_RESAMPLE_LEN - 1);
+        while (i + 1 < len - 1 && (float)(t_us[i + 1] - t_us[0]) < target)
+        {
+            i++;
+        }
+
+        float t0 = (float)(t_us[i] - t_us[0]);
+        float t1 = (float)(t_us[i + 1] - t_us[0]);
+        float frac = (t1 > t0) ? (target - t0) / (t1 - t0) : 0.0f;
+        frac = (frac < 0.0f) ? 0.0f : (frac > 1.0f) ? 1.0f : frac;
+
+        for (size_t axis = 0; axis < 3; ++axis)
+        {
+            out.axis[axis][k] = lerpCounts(in[axis], i, frac);
+        }
+    }
+}
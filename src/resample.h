@@ -0,0 +1,27 @@
+#ifndef __RESAMPLE_H
+#define __RESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of samples every template and attempt is resampled to before scoring
+#define GESTURE_RESAMPLE_LEN 64
+
+// Gesture normalised to GESTURE_RESAMPLE_LEN samples, kept as calibrated gyro counts
+// with one contiguous array per axis
+typedef struct
+{
+    int16_t axis[3][GESTURE_RESAMPLE_LEN]; // X, Y, Z samples
+} ResampledGesture;
+
+// Linearly interpolate len samples, given as one contiguous array per axis, onto
+// GESTURE_RESAMPLE_LEN evenly spaced points, rounding to the nearest count. An empty
+// input yields all zeros; a single sample is repeated.
+void resampleGesture(const int16_t *x, const int16_t *y, const int16_t *z, size_t len, ResampledGesture &out);
+
+// Time-aware variant: the output points are evenly spaced in time between the first
+// and last timestamps (us, non-decreasing), so uneven sample spacing is undone. Falls
+// back to index spacing if the timestamps span no time.
+void resampleGestureTimed(const int16_t *x, const int16_t *y, const int16_t *z, const uint32_t *t_us, size_t len, ResampledGesture &out);
+
+#endif
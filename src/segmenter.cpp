@@ -0,0 +1,56 @@
+#include "segmenter.h"
+
+// Configure the segmenter
+void initSegmenter(GestureSegmenter &seg, float onset_dps, float release_dps, uint16_t quiet_samples, uint16_t min_motion_samples)
+{
+    seg.onset_energy = onset_dps * onset_dps;
+    seg.release_energy = release_dps * release_dps;
+    seg.quiet_samples = quiet_samples;
+    seg.min_motion_samples = min_motion_samples;
+
+    seg.state = SEGMENT_IDLE;
+    seg.recorded = 0;
+    seg.motion_len = 0;
+    seg.quiet = 0;
+}
+
+// Feed the next calibrated sample and get the resulting phase
+SegmentState updateSegmenter(GestureSegmenter &seg, const std::array<float, 3> &sample)
+{
+    float energy = sample[0] * sample[0] + sample[1] * sample[1] + sample[2] * sample[2];
+
+    switch (seg.state)
+    {
+    case SEGMENT_IDLE:
+        if (energy > seg.onset_energy)
+        {
+            seg.state = SEGMENT_MOTION;
+            seg.recorded = 1;
+            seg.motion_len = 1;
+            seg.quiet = 0;
+        }
+        break;
+
+    case SEGMENT_MOTION:
+        seg.recorded++;
+        // Between the two thresholds the gesture is still considered in progress
+        if (energy < seg.release_energy)
+        {
+            if (++seg.quiet >= seg.quiet_samples)
+            {
+                seg.state = (seg.motion_len >= seg.min_motion_samples) ? SEGMENT_DONE : SEGMENT_IDLE;
+            }
+        }
+        else
+        {
+            seg.quiet = 0;
+            seg.motion_len = seg.recorded;
+        }
+        break;
+
+    case SEGMENT_DONE:
+        break;
+    }
+
+    return seg.state;
+}
@@ -0,0 +1,36 @@
+#ifndef __SEGMENTER_H
+#define __SEGMENTER_H
+
+#include <array>
+#include <stdint.h>
+
+// Phase of the gesture being captured
+typedef enum
+{
+    SEGMENT_IDLE,   // Waiting for motion onset
+    SEGMENT_MOTION, // Gesture in progress (may include short pauses)
+    SEGMENT_DONE    // Quiet period elapsed; gesture complete
+} SegmentState;
+
+// Streaming end-of-gesture detector with energy hysteresis
+typedef struct
+{
+    float onset_energy;          // Squared rate (dps^2) that starts a gesture
+    float release_energy;        // Squared rate below which the board counts as still
+    uint16_t quiet_samples;      // Consecutive still samples that end the gesture
+    uint16_t min_motion_samples; // Shorter bursts are discarded as blips
+
+    SegmentState state;  // Current phase
+    uint32_t recorded;   // Samples since onset, including the current one
+    uint32_t motion_len; // Samples from onset through the last moving sample
+    uint16_t quiet;      // Consecutive still samples so far
+} GestureSegmenter;
+
+// Configure the segmenter; rates are in dps and release_dps should be below onset_dps
+void initSegmenter(GestureSegmenter &seg, float onset_dps, float release_dps, uint16_t quiet_samples, uint16_t min_motion_samples);
+
+// Feed the next calibrated sample (dps) and get the resulting phase. Returning to
+// SEGMENT_IDLE from SEGMENT_MOTION means the burst was too short to be a gesture.
+SegmentState updateSegmenter(GestureSegmenter &seg, const std::array<float, 3> &sample);
+
+#endif
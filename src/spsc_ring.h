@@ -0,0 +1,99 @@
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cache line size the indices are padded to, so producer and consumer never share a
+// line on cores that have a data cache (the Cortex-M4 has none; this costs a few bytes)
+#define SPSC_CACHE_LINE 32
+
+// Fixed-capacity single-producer/single-consumer ring. push() may run in an ISR or a
+// higher-priority thread and pop() in another thread; both are wait-free. N must be a
+// power of two. The indices run freely and are masked on access.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N != 0 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), overruns(0), high_water(0) {}
+
+    // Producer: append an item; when the ring is full the item is dropped and counted
+    bool push(const T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t used = h - tail.load(std::memory_order_acquire);
+        if (used >= N)
+        {
+            overruns++;
+            return false;
+        }
+
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        if (used + 1 > high_water)
+        {
+            high_water = used + 1;
+        }
+        return true;
+    }
+
+    // Consumer: take the oldest item; returns false if the ring is empty
+    bool pop(T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items waiting (exact for the consumer, a lower bound for anyone else)
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity()
+    {
+        return N;
+    }
+
+    // Items dropped because the ring was full, and the deepest fill seen
+    uint32_t overrunCount() const
+    {
+        return overruns;
+    }
+    size_t highWaterMark() const
+    {
+        return high_water;
+    }
+
+    // Empty the ring and clear the counters; only while neither side is running
+    void reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        overruns = 0;
+        high_water = 0;
+    }
+
+private:
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> head; // Next slot to write (producer)
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail; // Next slot to read (consumer)
+
+    // Producer-side statistics
+    alignas(SPSC_CACHE_LINE) uint32_t overruns;
+    size_t high_water;
+
+    alignas(SPSC_CACHE_LINE) T items[N];
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "status_line.h"
+
+static const char *const messageText[STATUS_KEY_SAVED] = {
+    "NO KEY RECORDED",
+    "LOCKED",
+    "Configuring...",
+    "Recording...",
+    "Recording complete",
+    "Saving key...",
+    "Key not saved!",
+    "No key to match.",
+    "UNLOCK SUCCESS",
+    "UNLOCK FAILED",
+};
+
+static uint32_t slotAddress(const StatusLine &line, size_t slot)
+{
+    return STATUS_LINE_CACHE + slot * line.slotBytes;
+}
+
+void initStatusLine(StatusLine &line, LCD_DISCO_F429ZI &display, uint32_t layer, uint16_t x, uint16_t y)
+{
+    sFONT *font = display.GetFont();
+    uint32_t xSize = display.GetXSize();
+    // Characters per line, as DisplayStringAt counts them
+    uint32_t columns = xSize / font->Width;
+
+    line.display = &display;
+    line.layer = layer;
+    line.y = y;
+    line.height = font->Height;
+    // Room for the widest pixel format, whatever the layer is switched to later
+    line.slotBytes = xSize * line.height * 4;
+    MBED_ASSERT(STATUS_SLOTS * line.slotBytes <= STATUS_LINE_CACHE_SIZE);
+
+    char text[32];
+    for (size_t slot = 0; slot < STATUS_SLOTS; ++slot)
+    {
+        if (slot < STATUS_KEY_SAVED)
+        {
+            snprintf(text, sizeof(text), "%s", messageText[slot]);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "Key %d saved...", (int)(slot - STATUS_KEY_SAVED + 1));
+        }
+
+        // Same drawing as the old in-place updates; the idle messages are black
+        display.SetTextColor(LCD_COLOR_BLACK);
+        display.FillRect(0, y, xSize, line.height);
+        display.SetTextColor((slot == STATUS_NO_KEY || slot == STATUS_LOCKED) ? LCD_COLOR_BLACK : LCD_COLOR_BLUE);
+        display.DisplayStringAt(x, y, (uint8_t *)text, CENTER_MODE);
+        display.SaveLines(y, line.height, slotAddress(line, slot));
+
+        // Text extent, from the CENTER_MODE placement
+        uint32_t len = strlen(text);
+        len = (len < columns) ? len : columns;
+        line.x0[slot] = x + ((columns - len) * font->Width) / 2;
+        line.x1[slot] = line.x0[slot] + len * font->Width;
+    }
+
+    line.current = STATUS_NO_KEY;
+    display.RestoreLines(0, y, xSize, line.height, slotAddress(line, STATUS_NO_KEY));
+    display.SwapBuffers(layer);
+}
+
+void showStatus(StatusLine &line, StatusMessage msg, size_t keyIndex)
+{
+    size_t slot = msg;
+    if (msg == STATUS_KEY_SAVED)
+    {
+        slot += (keyIndex < GESTURE_LIBRARY_CAPACITY) ? keyIndex : GESTURE_LIBRARY_CAPACITY - 1;
+    }
+
+    line.lock.lock();
+    if (slot != line.current)
+    {
+        // Outside both texts the line is background in either message
+        uint16_t x0 = (line.x0[slot] < line.x0[line.current]) ? line.x0[slot] : line.x0[line.current];
+        uint16_t x1 = (line.x1[slot] > line.x1[line.current]) ? line.x1[slot] : line.x1[line.current];
+        line.display->RestoreLines(x0, line.y, x1 - x0, line.height, slotAddress(line, slot));
+        line.display->SwapBuffers(line.layer);
+        line.current = slot;
+    }
+    line.lock.unlock();
+}
@@ -0,0 +1,59 @@
+#ifndef __STATUS_LINE_H
+#define __STATUS_LINE_H
+
+#include <mbed.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gesture_library.h"
+#include "drivers/LCD_DISCO_F429ZI.h"
+
+// Pre-rendered lines live in the free SDRAM between the converted frame buffer
+// and the glyph atlas
+#define STATUS_LINE_CACHE (LCD_FRAME_BUFFER + 0x400000)
+#define STATUS_LINE_CACHE_SIZE ((uint32_t)0x300000)
+
+// Every message the status line can show; STATUS_KEY_SAVED is followed by one slot
+// per library entry ("Key 1 saved...", "Key 2 saved...", ...)
+typedef enum
+{
+    STATUS_NO_KEY,
+    STATUS_LOCKED,
+    STATUS_CONFIGURING,
+    STATUS_RECORDING,
+    STATUS_RECORDING_COMPLETE,
+    STATUS_SAVING_KEY,
+    STATUS_KEY_NOT_SAVED,
+    STATUS_NO_KEY_TO_MATCH,
+    STATUS_UNLOCK_SUCCESS,
+    STATUS_UNLOCK_FAILED,
+    STATUS_KEY_SAVED
+} StatusMessage;
+
+#define STATUS_SLOTS (STATUS_KEY_SAVED + GESTURE_LIBRARY_CAPACITY)
+
+// One text line of the display whose messages are rasterized once into SDRAM;
+// showing a message copies back only the columns that differ from the current one
+typedef struct
+{
+    LCD_DISCO_F429ZI *display;
+    uint32_t layer;
+    uint16_t y;
+    uint16_t height;
+    uint32_t slotBytes; // Cache space per message
+    size_t current;     // Slot on screen
+    uint16_t x0[STATUS_SLOTS]; // Text columns [x0, x1) of each slot
+    uint16_t x1[STATUS_SLOTS];
+    Mutex lock;
+} StatusLine;
+
+// Render every message at (x, y) with the current font and cache it, then flip the
+// layer with the line showing STATUS_NO_KEY. The layer must be the active one.
+void initStatusLine(StatusLine &line, LCD_DISCO_F429ZI &display, uint32_t layer, uint16_t x, uint16_t y);
+
+// Show a message and flip the layer; keyIndex picks the slot of STATUS_KEY_SAVED.
+// Calls are serialised against each other only: the BSP drawing state has no lock, so
+// no other thread may draw on the display once initStatusLine has run.
+void showStatus(StatusLine &line, StatusMessage msg, size_t keyIndex = 0);
+
+#endif
@@ -0,0 +1,98 @@
+#include "streaming_dtw.h"
+
+using std::array;
+
+// Start matching a template
+void initStreamingDTW(StreamingDTW &state, const GestureQ15 &query, uint32_t threshold)
+{
+    state.query = query;
+    state.query.length = (query.length > MAX_GESTURE_SAMPLES) ? MAX_GESTURE_SAMPLES : query.length;
+    state.threshold = threshold;
+    state.samples = 0;
+
+    state.dist[0] = 0;
+    state.start[0] = 0;
+    for (size_t i = 1; i <= state.query.length; ++i)
+    {
+        state.dist[i] = Q15_DTW_INFINITY;
+        state.start[i] = 0;
+    }
+
+    state.best_dist = Q15_DTW_INFINITY;
+    state.best_start = 0;
+    state.best_end = 0;
+    state.matched = false;
+}
+
+// Feed the next stream sample
+bool updateStreamingDTW(StreamingDTW &state, const array<int16_t, 3> &sample)
+{
+    const GestureQ15 &q = state.query;
+    size_t m = q.length;
+    uint32_t t = state.samples++;
+
+    if (state.matched || m == 0)
+    {
+        return state.matched;
+    }
+
+    // Update the single column in place; a match may start at any stream sample
+    uint32_t diagDist = 0;
+    uint32_t diagStart = t;
+    state.dist[0] = 0;
+    state.start[0] = t;
+
+    for (size_t i = 1; i <= m; ++i)
+    {
+        uint32_t upDist = state.dist[i];
+        uint32_t upStart = state.start[i];
+
+        uint32_t best = state.dist[i - 1];
+        uint32_t bestStart = state.start[i - 1];
+        if (upDist < best)
+        {
+            best = upDist;
+            bestStart = upStart;
+        }
+        if (diagDist < best)
+        {
+            best = diagDist;
+            bestStart = diagStart;
+        }
+
+        array<int16_t, 3> point = {q.axis[0][i - 1], q.axis[1][i - 1], q.axis[2][i - 1]};
+        state.dist[i] = (best == Q15_DTW_INFINITY) ? Q15_DTW_INFINITY : calcDistQ15(sample, point) + best;
+        state.start[i] = bestStart;
+
+        diagDist = upDist;
+        diagStart = upStart;
+    }
+
+    // Confirm the candidate once every live path is either worse or started after it ended
+    if (state.best_dist <= state.threshold)
+    {
+        bool confirmed = true;
+        for (size_t i = 1; i <= m; ++i)
+        {
+            if (state.dist[i] < state.best_dist && state.start[i] <= state.best_end)
+            {
+                confirmed = false;
+                break;
+            }
+        }
+        if (confirmed)
+        {
+            state.matched = true;
+            return true;
+        }
+    }
+
+    if (state.dist[m] <= state.threshold && state.dist[m] < state.best_dist)
+    {
+        state.best_dist = state.dist[m];
+        state.best_start = state.start[m];
+        state.best_end = t;
+    }
+
+    return false;
+}
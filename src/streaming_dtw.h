@@ -0,0 +1,37 @@
+#ifndef __STREAMING_DTW_H
+#define __STREAMING_DTW_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "q15.h"
+
+// SPRING-style subsequence DTW matcher fed one sample at a time. It tracks the
+// best match of the whole template against any stretch of the incoming stream,
+// and confirms it once no path still in progress can improve on it. Samples and
+// distances are in calibrated counts, with cells costed by calcDistQ15.
+typedef struct
+{
+    GestureQ15 query;   // Template being searched for (length <= MAX_GESTURE_SAMPLES)
+    uint32_t threshold; // Largest accepted DTW distance
+
+    uint32_t dist[MAX_GESTURE_SAMPLES + 1];  // Cumulative distance per template sample
+    uint32_t start[MAX_GESTURE_SAMPLES + 1]; // Stream index where each path started
+    uint32_t samples;                        // Stream samples consumed so far
+
+    uint32_t best_dist;  // Best candidate match so far (Q15_DTW_INFINITY if none)
+    uint32_t best_start; // First stream sample of the candidate
+    uint32_t best_end;   // Last stream sample of the candidate
+    bool matched;        // Candidate has been confirmed
+} StreamingDTW;
+
+// Start matching a template; threshold is the largest accepted DTW distance
+void initStreamingDTW(StreamingDTW &state, const GestureQ15 &query, uint32_t threshold);
+
+// Feed the next stream sample; returns true once a match is confirmed. The match
+// covers stream samples best_start..best_end and stays reported until re-initialised.
+bool updateStreamingDTW(StreamingDTW &state, const std::array<int16_t, 3> &sample);
+
+#endif
@@ -0,0 +1,31 @@
+#include "template_cache.h"
+
+// Block-average a resampled gesture into its coarse copy
+void downsampleGesture(const ResampledGesture &in, CoarseGesture &out)
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t c = 0; c < TEMPLATE_COARSE_LEN; ++c)
+        {
+            int32_t acc = 0;
+            for (size_t i = 0; i < TEMPLATE_COARSE_FACTOR; ++i)
+            {
+                acc += in.axis[k][c * TEMPLATE_COARSE_FACTOR + i];
+            }
+            out.axis[k][c] = (int16_t)(acc / TEMPLATE_COARSE_FACTOR);
+        }
+    }
+}
+
+// Build the cache of a resampled template
+void buildTemplateCache(const ResampledGesture &key, size_t window, TemplateCache &cache)
+{
+    GestureQ15 view = viewGestureQ15(key);
+
+    calcCorrelationStatsQ15(view, cache.stats);
+
+    cache.window = window;
+    calcDTWEnvelopeQ15(view, window, cache.upper, cache.lower);
+
+    downsampleGesture(key, cache.coarse);
+}
@@ -0,0 +1,44 @@
+#ifndef __TEMPLATE_CACHE_H
+#define __TEMPLATE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resample.h"
+#include "q15.h"
+
+// Block size used for the coarse copy of a template
+#define TEMPLATE_COARSE_FACTOR 4
+#define TEMPLATE_COARSE_LEN (GESTURE_RESAMPLE_LEN / TEMPLATE_COARSE_FACTOR)
+
+// Block-averaged gesture used for quick coarse ranking, in counts
+typedef struct
+{
+    int16_t axis[3][TEMPLATE_COARSE_LEN];
+} CoarseGesture;
+
+// Everything about an enrolled template that unlock scoring would otherwise
+// recompute on every attempt, built once at enrollment
+typedef struct
+{
+    CorrelationStatsQ15 stats; // Template side of the correlation
+    ResampledGesture upper;    // LB_Keogh envelope for a resampled attempt
+    ResampledGesture lower;
+    size_t window;             // DTW band the envelope was built for
+    CoarseGesture coarse;      // Downsampled copy
+} TemplateCache;
+
+// View of a coarse copy, for the integer DTW kernel
+static inline GestureQ15 viewGestureQ15(const CoarseGesture &g)
+{
+    GestureQ15 view = {{g.axis[0], g.axis[1], g.axis[2]}, TEMPLATE_COARSE_LEN};
+    return view;
+}
+
+// Build the cache of a resampled template for the given DTW band
+void buildTemplateCache(const ResampledGesture &key, size_t window, TemplateCache &cache);
+
+// Block-average a resampled gesture into its coarse copy
+void downsampleGesture(const ResampledGesture &in, CoarseGesture &out);
+
+#endif
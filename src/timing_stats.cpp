@@ -0,0 +1,50 @@
+#include <mbed.h>
+#include "hal/us_ticker_api.h"
+
+#include "timing_stats.h"
+
+// Free-running microsecond timestamp, from the same 64-bit ticker Timer uses
+uint32_t readTimestampUs()
+{
+    return (uint32_t)ticker_read_us(get_us_ticker_data());
+}
+
+// Clear the histogram and set its bin width
+void resetIntervalHistogram(IntervalHistogram &hist, uint32_t bin_us)
+{
+    memset(&hist, 0, sizeof(hist));
+    hist.bin_us = (bin_us == 0) ? 1 : bin_us;
+    hist.min_us = UINT32_MAX;
+}
+
+// Record one interval
+void addInterval(IntervalHistogram &hist, uint32_t interval_us)
+{
+    uint32_t bin = interval_us / hist.bin_us;
+    hist.bins[(bin < INTERVAL_HIST_BINS) ? bin : INTERVAL_HIST_BINS - 1]++;
+    hist.count++;
+    hist.min_us = (interval_us < hist.min_us) ? interval_us : hist.min_us;
+    hist.max_us = (interval_us > hist.max_us) ? interval_us : hist.max_us;
+}
+
+// Upper edge of the bin holding the given fraction of intervals
+uint32_t intervalPercentile(const IntervalHistogram &hist, float fraction)
+{
+    if (hist.count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t rank = (uint32_t)ceilf(fraction * hist.count);
+    uint32_t seen = 0;
+    for (uint32_t b = 0; b < INTERVAL_HIST_BINS; ++b)
+    {
+        seen += hist.bins[b];
+        if (seen >= rank)
+        {
+            uint32_t edge = (b + 1) * hist.bin_us;
+            return (edge < hist.max_us) ? edge : hist.max_us;
+        }
+    }
+    return hist.max_us;
+}
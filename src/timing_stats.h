@@ -0,0 +1,43 @@
+#ifndef __TIMING_STATS_H
+#define __TIMING_STATS_H
+
+#include <stdint.h>
+
+#include "motion.h"
+
+// Number of histogram bins; the last one also collects everything beyond the range
+#define INTERVAL_HIST_BINS 64
+
+// Raw sample tagged with the time (us) it became ready in the sensor. The FIFO gives one
+// edge per block, so only the sample that raised it is timed directly; the others are
+// placed at the sensor period measured between edges.
+typedef struct
+{
+    RotationSensor_RawValues raw;
+    uint32_t t_us;
+} TimedSample;
+
+// Histogram of time intervals with exact extremes
+typedef struct
+{
+    uint32_t bin_us; // Width of one bin
+    uint32_t bins[INTERVAL_HIST_BINS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+} IntervalHistogram;
+
+// Free-running microsecond timestamp (wraps every ~71 minutes; differences stay valid)
+uint32_t readTimestampUs();
+
+// Clear the histogram and set its bin width
+void resetIntervalHistogram(IntervalHistogram &hist, uint32_t bin_us);
+
+// Record one interval
+void addInterval(IntervalHistogram &hist, uint32_t interval_us);
+
+// Upper edge of the bin holding the given fraction (0..1) of intervals, capped at the
+// true maximum; 0 if the histogram is empty
+uint32_t intervalPercentile(const IntervalHistogram &hist, float fraction);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef __HOST_CMSIS_H
+#define __HOST_CMSIS_H
+
+#include <stdint.h>
+
+// Host emulation of the Cortex-M4 SIMD instructions used by q15.cpp, following
+// the ARMv7-M pseudocode (results wrap exactly as on the core)
+
+static inline int32_t lo16(uint32_t x)
+{
+    return (int16_t)(x & 0xFFFF);
+}
+
+static inline int32_t hi16(uint32_t x)
+{
+    return (int16_t)(x >> 16);
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    return acc + (uint32_t)(lo16(x) * lo16(y)) + (uint32_t)(hi16(x) * hi16(y));
+}
+
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t acc)
+{
+    return acc + (uint64_t)(int64_t)(lo16(x) * lo16(y)) + (uint64_t)(int64_t)(hi16(x) * hi16(y));
+}
+
+static inline uint32_t __SHSUB16(uint32_t x, uint32_t y)
+{
+    uint32_t lo = (uint32_t)((lo16(x) - lo16(y)) >> 1) & 0xFFFF;
+    uint32_t hi = (uint32_t)((hi16(x) - hi16(y)) >> 1) & 0xFFFF;
+    return lo | (hi << 16);
+}
+
+static inline uint32_t __SMUAD(uint32_t x, uint32_t y)
+{
+    return (uint32_t)(lo16(x) * lo16(y)) + (uint32_t)(hi16(x) * hi16(y));
+}
+
+#endif
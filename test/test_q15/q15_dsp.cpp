@@ -0,0 +1,15 @@
+// Second build of the integer kernels for the Cortex-M4 instruction path, against
+// the emulated intrinsics in cmsis.h. The entry points get a dsp_ prefix so the
+// test can compare both paths bit for bit.
+#define Q15_USE_DSP 1
+#define calcDistQ15 dsp_calcDistQ15
+#define calcCorrelationVecsQ15 dsp_calcCorrelationVecsQ15
+#define calcCorrelationStatsQ15 dsp_calcCorrelationStatsQ15
+#define calcCorrelationCachedQ15 dsp_calcCorrelationCachedQ15
+#define calcDTWQ15 dsp_calcDTWQ15
+#define calcLBKimQ15 dsp_calcLBKimQ15
+#define calcDTWEnvelopeQ15 dsp_calcDTWEnvelopeQ15
+#define calcLBKeoghQ15 dsp_calcLBKeoghQ15
+#define scoreDTWCascadeQ15 dsp_scoreDTWCascadeQ15
+
+#include "../../src/q15.cpp"
@@ -0,0 +1,308 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include <array>
+
+#include "q15.h"
+#include "dtw.h"
+#include "resample.h"
+#include "template_cache.h"
+
+// Cortex-M4 instruction path, built by q15_dsp.cpp
+bool dsp_calcCorrelationVecsQ15(const GestureQ15 &a, const GestureQ15 &b, std::array<int16_t, 3> &result);
+bool dsp_calcCorrelationCachedQ15(const GestureQ15 &key, const CorrelationStatsQ15 &stats, const GestureQ15 &attempt,
+                                  std::array<int16_t, 3> &result);
+uint32_t dsp_calcDTWQ15(const GestureQ15 &s, const GestureQ15 &t, size_t window, uint32_t threshold);
+
+using std::array;
+
+static uint32_t rngState;
+
+// Deterministic pseudo-random rate in [-range, range) dps
+static float randomRate(float range)
+{
+    rngState = rngState * 1664525u + 1013904223u;
+    return ((rngState >> 8) / 16777216.0f * 2.0f - 1.0f) * range;
+}
+
+// Smooth gesture-like sequence: a few random sines per axis plus sensor noise
+static void makeGesture(array<float, 3> *seq, size_t len, float range)
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        float amp[3], freq[3], phase[3];
+        for (size_t h = 0; h < 3; ++h)
+        {
+            amp[h] = fabsf(randomRate(range / 3));
+            freq[h] = 0.5f + fabsf(randomRate(3.0f));
+            phase[h] = randomRate(3.14159f);
+        }
+        for (size_t i = 0; i < len; ++i)
+        {
+            float t = (float)i / len;
+            float v = randomRate(2.0f);
+            for (size_t h = 0; h < 3; ++h)
+            {
+                v += amp[h] * sinf(2 * 3.14159f * freq[h] * t + phase[h]);
+            }
+            seq[i][k] = v;
+        }
+    }
+}
+
+// Sensor counts of a sequence in dps, saturating like the gyro output does
+static GestureQ15 toCounts(const array<float, 3> *seq, size_t len, int16_t (*axis)[MAX_GESTURE_SAMPLES])
+{
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            float counts = roundf(seq[i][k] / Q15_DPS_PER_COUNT);
+            counts = (counts > INT16_MAX) ? INT16_MAX : (counts < INT16_MIN) ? INT16_MIN : counts;
+            axis[k][i] = (int16_t)counts;
+        }
+    }
+    GestureQ15 view = {{axis[0], axis[1], axis[2]}, len};
+    return view;
+}
+
+// Rates in dps of a gesture in counts
+static void toRates(const GestureQ15 &g, array<float, 3> *seq)
+{
+    for (size_t i = 0; i < g.length; ++i)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            seq[i][k] = g.axis[k][i] * Q15_DPS_PER_COUNT;
+        }
+    }
+}
+
+// Resampled gesture in counts from a sequence in dps
+static void toResampled(const array<float, 3> *seq, ResampledGesture &out)
+{
+    static int16_t axis[3][MAX_GESTURE_SAMPLES];
+    toCounts(seq, GESTURE_RESAMPLE_LEN, axis);
+    for (size_t k = 0; k < 3; ++k)
+    {
+        memcpy(out.axis[k], axis[k], sizeof(out.axis[k]));
+    }
+}
+
+// Float Pearson correlation of one axis
+static float correlation(const array<float, 3> *a, const array<float, 3> *b, size_t n, size_t k)
+{
+    double sa = 0, sb = 0, sab = 0, saa = 0, sbb = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sa += a[i][k];
+        sb += b[i][k];
+        sab += (double)a[i][k] * b[i][k];
+        saa += (double)a[i][k] * a[i][k];
+        sbb += (double)b[i][k] * b[i][k];
+    }
+    return (float)((n * sab - sa * sb) / sqrt((n * saa - sa * sa) * (n * sbb - sb * sb)));
+}
+
+static array<float, 3> seqA[MAX_GESTURE_SAMPLES];
+static array<float, 3> seqB[MAX_GESTURE_SAMPLES];
+static int16_t countsA[3][MAX_GESTURE_SAMPLES];
+static int16_t countsB[3][MAX_GESTURE_SAMPLES];
+
+void setUp()
+{
+    rngState = 12345;
+}
+
+void tearDown()
+{
+}
+
+// The DSP path must produce the same distances as the portable reference,
+// including at full scale where the halved differences reach the int16 limits
+void test_dtw_dsp_matches_reference()
+{
+    const size_t lengths[][2] = {{64, 64}, {64, 41}, {1, 7}, {256, 200}, {33, 64}};
+    const float ranges[] = {50.0f, 500.0f, 4000.0f};
+
+    for (const auto &len : lengths)
+    {
+        for (float range : ranges)
+        {
+            makeGesture(seqA, len[0], range);
+            makeGesture(seqB, len[1], range);
+            GestureQ15 gestA = toCounts(seqA, len[0], countsA);
+            GestureQ15 gestB = toCounts(seqB, len[1], countsB);
+
+            for (size_t window : {(size_t)0, (size_t)4, (size_t)13, DTW_FULL_WINDOW})
+            {
+                uint32_t ref = calcDTWQ15(gestA, gestB, window, Q15_DTW_INFINITY);
+                TEST_ASSERT_EQUAL_UINT32(ref, dsp_calcDTWQ15(gestA, gestB, window, Q15_DTW_INFINITY));
+                TEST_ASSERT_EQUAL_UINT32(calcDTWQ15(gestA, gestB, window, ref / 2),
+                                         dsp_calcDTWQ15(gestA, gestB, window, ref / 2));
+            }
+        }
+    }
+}
+
+// Same for the correlation sums, with odd lengths exercising the scalar tail; the
+// cached variant must match the uncached one exactly
+void test_correlation_dsp_matches_reference()
+{
+    const size_t lengths[] = {64, 63, 2, 255};
+    const float ranges[] = {50.0f, 4000.0f};
+
+    for (size_t len : lengths)
+    {
+        for (float range : ranges)
+        {
+            makeGesture(seqA, len, range);
+            makeGesture(seqB, len, range);
+            GestureQ15 gestA = toCounts(seqA, len, countsA);
+            GestureQ15 gestB = toCounts(seqB, len, countsB);
+
+            array<int16_t, 3> ref, fast, cached, fastCached;
+            bool refValid = calcCorrelationVecsQ15(gestA, gestB, ref);
+            TEST_ASSERT_EQUAL(refValid, dsp_calcCorrelationVecsQ15(gestA, gestB, fast));
+            TEST_ASSERT_EQUAL_INT16_ARRAY(ref.data(), fast.data(), 3);
+
+            CorrelationStatsQ15 stats;
+            calcCorrelationStatsQ15(gestA, stats);
+            TEST_ASSERT_EQUAL(refValid, calcCorrelationCachedQ15(gestA, stats, gestB, cached));
+            TEST_ASSERT_EQUAL(refValid, dsp_calcCorrelationCachedQ15(gestA, stats, gestB, fastCached));
+            TEST_ASSERT_EQUAL_INT16_ARRAY(ref.data(), cached.data(), 3);
+            TEST_ASSERT_EQUAL_INT16_ARRAY(ref.data(), fastCached.data(), 3);
+        }
+    }
+}
+
+// Integer DTW stays within the halving error of the float kernel on the same counts:
+// a few counts per warping-path cell, and a path has fewer than s_len + t_len cells
+void test_dtw_q15_tracks_float()
+{
+    const size_t lengths[][2] = {{64, 64}, {64, 48}, {20, 64}};
+
+    for (const auto &len : lengths)
+    {
+        makeGesture(seqA, len[0], 300.0f);
+        makeGesture(seqB, len[1], 300.0f);
+        GestureQ15 gestA = toCounts(seqA, len[0], countsA);
+        GestureQ15 gestB = toCounts(seqB, len[1], countsB);
+        toRates(gestA, seqA);
+        toRates(gestB, seqB);
+
+        size_t window = calcDTWWindow(len[0], len[1], 20.0f);
+        float ref = calcDTWBand(seqA, len[0], seqB, len[1], window) / Q15_DPS_PER_COUNT;
+        uint32_t q15 = calcDTWQ15(gestA, gestB, window, Q15_DTW_INFINITY);
+        float tolerance = (len[0] + len[1]) * 6;
+        TEST_ASSERT_FLOAT_WITHIN(tolerance, ref, (float)q15);
+
+        // Abandons below the true distance, completes above it
+        TEST_ASSERT_EQUAL_UINT32(Q15_DTW_INFINITY, calcDTWQ15(gestA, gestB, window, q15 / 2));
+        TEST_ASSERT_EQUAL_UINT32(q15, calcDTWQ15(gestA, gestB, window, q15));
+    }
+}
+
+// The lower bounds never exceed the distance they bound, in either argument order,
+// and the cascade returns the plain distance whenever it does not prune
+void test_lower_bounds_hold()
+{
+    const float ranges[] = {20.0f, 300.0f, 4000.0f};
+    size_t window = calcDTWWindow(GESTURE_RESAMPLE_LEN, GESTURE_RESAMPLE_LEN, 20.0f);
+
+    for (float range : ranges)
+    {
+        for (int trial = 0; trial < 20; ++trial)
+        {
+            ResampledGesture key, attempt, upper, lower;
+            makeGesture(seqA, GESTURE_RESAMPLE_LEN, range);
+            makeGesture(seqB, GESTURE_RESAMPLE_LEN, range);
+            toResampled(seqA, key);
+            toResampled(seqB, attempt);
+            GestureQ15 keyView = viewGestureQ15(key);
+            GestureQ15 attemptView = viewGestureQ15(attempt);
+
+            uint32_t dist = calcDTWQ15(keyView, attemptView, window, Q15_DTW_INFINITY);
+            TEST_ASSERT_TRUE(calcLBKimQ15(keyView, attemptView) <= dist);
+            TEST_ASSERT_TRUE(calcLBKimQ15(attemptView, keyView) <= dist);
+
+            TEST_ASSERT_TRUE(calcDTWEnvelopeQ15(keyView, window, upper, lower));
+            TEST_ASSERT_TRUE(calcLBKeoghQ15(attemptView, upper, lower) <= dist);
+
+            TEST_ASSERT_EQUAL_UINT32(dist, scoreDTWCascadeQ15(keyView, attemptView, &upper, &lower, window, Q15_DTW_INFINITY));
+            TEST_ASSERT_EQUAL_UINT32(dist, scoreDTWCascadeQ15(keyView, attemptView, &upper, &lower, window, dist));
+            TEST_ASSERT_EQUAL_UINT32(Q15_DTW_INFINITY, scoreDTWCascadeQ15(keyView, attemptView, &upper, &lower, window, dist - 1));
+        }
+    }
+}
+
+// Integer correlation agrees with a float Pearson correlation of the same rates
+void test_correlation_q15_tracks_float()
+{
+    ResampledGesture key, attempt;
+    makeGesture(seqA, GESTURE_RESAMPLE_LEN, 300.0f);
+    for (size_t i = 0; i < GESTURE_RESAMPLE_LEN; ++i)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            seqB[i][k] = seqA[i][k] * 0.8f + randomRate(60.0f);
+        }
+    }
+    toResampled(seqA, key);
+    toResampled(seqB, attempt);
+
+    TemplateCache cache;
+    buildTemplateCache(key, calcDTWWindow(GESTURE_RESAMPLE_LEN, GESTURE_RESAMPLE_LEN, 20.0f), cache);
+
+    array<int16_t, 3> q15;
+    TEST_ASSERT_TRUE(calcCorrelationCachedQ15(viewGestureQ15(key), cache.stats, viewGestureQ15(attempt), q15));
+    for (size_t k = 0; k < 3; ++k)
+    {
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, correlation(seqA, seqB, GESTURE_RESAMPLE_LEN, k), (float)q15[k] / Q15_ONE);
+    }
+
+    // A flat axis is reported as invalid
+    for (size_t i = 0; i < GESTURE_RESAMPLE_LEN; ++i)
+    {
+        attempt.axis[2][i] = 286;
+    }
+    TEST_ASSERT_FALSE(calcCorrelationCachedQ15(viewGestureQ15(key), cache.stats, viewGestureQ15(attempt), q15));
+}
+
+// Evenly spaced timestamps resample exactly like index spacing
+void test_resample_timed_matches_even_spacing()
+{
+    const size_t len = 100;
+    static int16_t axis[3][len];
+    static uint32_t t_us[len];
+    for (size_t i = 0; i < len; ++i)
+    {
+        axis[0][i] = (int16_t)(i * 37);
+        axis[1][i] = (int16_t)(-(int32_t)i * 11);
+        axis[2][i] = (int16_t)((i % 7) * 500);
+        t_us[i] = 0xFFFFF000u + (uint32_t)i * 40000u; // Wraps inside the gesture
+    }
+
+    ResampledGesture timed, even;
+    resampleGestureTimed(axis[0], axis[1], axis[2], t_us, len, timed);
+    resampleGesture(axis[0], axis[1], axis[2], len, even);
+    for (size_t k = 0; k < 3; ++k)
+    {
+        for (size_t i = 0; i < GESTURE_RESAMPLE_LEN; ++i)
+        {
+            TEST_ASSERT_INT_WITHIN(1, even.axis[k][i], timed.axis[k][i]);
+        }
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dtw_dsp_matches_reference);
+    RUN_TEST(test_correlation_dsp_matches_reference);
+    RUN_TEST(test_dtw_q15_tracks_float);
+    RUN_TEST(test_lower_bounds_hold);
+    RUN_TEST(test_correlation_q15_tracks_float);
+    RUN_TEST(test_resample_timed_matches_even_spacing);
+    return UNITY_END();
+}